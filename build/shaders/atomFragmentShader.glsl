@@ -4,6 +4,7 @@
 in vec3 FragPos;
 in vec3 Normal;
 in vec3 Color;
+in float Ambient;
 
 out vec4 FragColor;
 
@@ -29,7 +30,11 @@ void main()
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * vec3(1.0);
 
-    vec3 result = ambient + diffuse + specular;
+    // Ambient occlusion darkens ambient and diffuse light alike
+    float occlusionStrength = 0.8;
+    float occlusion = mix(1.0, Ambient, occlusionStrength);
+
+    vec3 result = (ambient + diffuse) * occlusion + specular;
     FragColor = vec4(result, 1.0);
 }
 
@@ -0,0 +1,56 @@
+#version 330 core
+
+in vec3 RayPoint;
+flat in vec3 SphereCenter;
+flat in float SphereRadius;
+flat in vec3 Color;
+flat in float Ambient;
+
+out vec4 FragColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 lightPos;
+
+void main()
+{
+    // Ray from the eye through this pixel, intersected with the sphere
+    vec3 rayDir = normalize(RayPoint);
+    float b = dot(rayDir, SphereCenter);
+    float c = dot(SphereCenter, SphereCenter) - SphereRadius * SphereRadius;
+    float disc = b * b - c;
+    if (disc < 0.0)
+        discard;
+    vec3 FragPos = rayDir * (b - sqrt(disc));
+    vec3 norm = (FragPos - SphereCenter) / SphereRadius;
+
+    // Depth of the hit point rather than of the quad
+    vec4 clipPos = projection * vec4(FragPos, 1.0);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5 + 0.5;
+
+    // Same lighting as atomFragmentShader.glsl, evaluated in view space
+    vec3 lightView = vec3(view * vec4(lightPos, 1.0));
+
+    // Ambient
+    float ambientStrength = 0.2;
+    vec3 ambient = ambientStrength * Color;
+
+    // Diffuse
+    vec3 lightDir = normalize(lightView - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * Color;
+
+    // Specular
+    float specularStrength = 0.3;
+    vec3 viewDir = normalize(-FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * vec3(1.0);
+
+    // Ambient occlusion darkens ambient and diffuse light alike
+    float occlusionStrength = 0.8;
+    float occlusion = mix(1.0, Ambient, occlusionStrength);
+
+    vec3 result = (ambient + diffuse) * occlusion + specular;
+    FragColor = vec4(result, 1.0);
+}
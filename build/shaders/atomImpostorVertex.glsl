@@ -0,0 +1,43 @@
+#version 330 core
+
+layout (location = 0) in vec2 aCorner;
+
+// Instance attributes
+layout (location = 3) in vec3 instancePos;
+layout (location = 4) in float instanceScale;
+layout (location = 5) in uint instanceColorIndex;
+layout (location = 7) in float instanceAmbient;
+
+// Everything is passed in view space, where the eye sits at the origin
+out vec3 RayPoint;
+flat out vec3 SphereCenter;
+flat out float SphereRadius;
+flat out vec3 Color;
+flat out float Ambient;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform samplerBuffer palette;
+
+void main()
+{
+    vec3 center = vec3(view * vec4(instancePos, 1.0));
+    float radius = instanceScale;
+
+    // Billboard facing the eye, through the sphere center. The silhouette cone of the
+    // sphere cuts this plane in a circle of radius r*d/sqrt(d^2 - r^2).
+    float dist = length(center);
+    vec3 toEye = -center / dist;
+    vec3 up = abs(toEye.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, toEye));
+    up = cross(toEye, right);
+    float halfSize = radius * dist / sqrt(max(dist * dist - radius * radius, 1e-6));
+
+    RayPoint = center + (aCorner.x * right + aCorner.y * up) * halfSize;
+    SphereCenter = center;
+    SphereRadius = radius;
+    Color = texelFetch(palette, int(instanceColorIndex)).rgb;
+    Ambient = instanceAmbient;
+
+    gl_Position = projection * vec4(RayPoint, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+// Index into the instance texture buffers
+layout (location = 6) in uint instanceId;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+out float Ambient;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform samplerBuffer palette;
+uniform samplerBuffer instancePositions;
+uniform usamplerBuffer instanceAppearance;
+
+void main()
+{
+    int id = int(instanceId);
+    vec3 instancePos = vec3(texelFetch(instancePositions, id * 3).r,
+                            texelFetch(instancePositions, id * 3 + 1).r,
+                            texelFetch(instancePositions, id * 3 + 2).r);
+    float instanceScale = uintBitsToFloat(texelFetch(instanceAppearance, id * 2).r);
+    uint appearance = texelFetch(instanceAppearance, id * 2 + 1).r;
+    uint instanceColorIndex = appearance & 0xFFu;
+
+    // Unit sphere: the vertex position is also its normal
+    FragPos = instancePos + aPos * instanceScale;
+    Normal = aPos;
+    Color = texelFetch(palette, int(instanceColorIndex)).rgb;
+    Ambient = float((appearance >> 8) & 0xFFu) / 255.0;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
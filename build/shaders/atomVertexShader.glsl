@@ -8,17 +8,30 @@ layout (location = 2) in vec2 aTexCoords;
 // Instance attributes
 layout (location = 3) in vec3 instancePos;
 layout (location = 4) in float instanceScale;
-layout (location = 5) in vec3 instanceColor;
+layout (location = 5) in uint instanceColorIndex;
+layout (location = 7) in float instanceAmbient;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 Color;
+out float Ambient;
 
 uniform mat4 view;
 uniform mat4 projection;
+uniform samplerBuffer palette;
 
 void main()
 {
+#ifdef UNIFORM_SCALE
+    // Spheres are only translated and uniformly scaled, so the normal matrix is the identity
+    // and no model matrix is needed
+    FragPos = instancePos + instanceScale * aPos;
+    Normal = aNormal;
+    Color = texelFetch(palette, int(instanceColorIndex)).rgb;
+    Ambient = instanceAmbient;
+
+    gl_Position = projection * (view * vec4(FragPos, 1.0));
+#else
     mat4 model = mat4(1.0);
     model[3].xyz = instancePos; // translate
     model = model * mat4(
@@ -30,8 +43,10 @@ void main()
 
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
-    Color = instanceColor;
+    Color = texelFetch(palette, int(instanceColorIndex)).rgb;
+    Ambient = instanceAmbient;
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+#endif
 }
 
@@ -0,0 +1,73 @@
+#version 330 core
+
+in vec3 RayPoint;
+flat in vec3 BondStart;
+flat in vec3 BondAxis;
+flat in float BondLength;
+flat in vec3 StartColor;
+flat in vec3 EndColor;
+flat in float StartAmbient;
+flat in float EndAmbient;
+
+out vec4 FragColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 lightPos;
+uniform float bondRadius;
+
+void main()
+{
+    // Ray from the eye through this pixel against the infinite cylinder around the axis:
+    // solve |perp(t * rayDir - BondStart)| = bondRadius, perp() removing the axis component
+    vec3 rayDir = normalize(RayPoint);
+    vec3 rayPerp = rayDir - dot(rayDir, BondAxis) * BondAxis;
+    vec3 toEye = -BondStart;
+    vec3 eyePerp = toEye - dot(toEye, BondAxis) * BondAxis;
+    float a = dot(rayPerp, rayPerp);
+    float b = dot(rayPerp, eyePerp);
+    float c = dot(eyePerp, eyePerp) - bondRadius * bondRadius;
+    float disc = b * b - a * c;
+    if (disc < 0.0 || a < 1e-8)
+        discard;
+    vec3 FragPos = rayDir * ((-b - sqrt(disc)) / a);
+
+    // Open ends: the atom spheres cover them
+    float along = dot(FragPos - BondStart, BondAxis);
+    if (along < 0.0 || along > BondLength)
+        discard;
+    vec3 norm = normalize(FragPos - BondStart - along * BondAxis);
+    // Each half takes the color and ambient light of its atom
+    vec3 Color = along < 0.5 * BondLength ? StartColor : EndColor;
+    float Ambient = along < 0.5 * BondLength ? StartAmbient : EndAmbient;
+
+    // Depth of the hit point rather than of the box
+    vec4 clipPos = projection * vec4(FragPos, 1.0);
+    gl_FragDepth = (clipPos.z / clipPos.w) * 0.5 + 0.5;
+
+    // Same lighting as atomImpostorFragment.glsl, evaluated in view space
+    vec3 lightView = vec3(view * vec4(lightPos, 1.0));
+
+    // Ambient
+    float ambientStrength = 0.2;
+    vec3 ambient = ambientStrength * Color;
+
+    // Diffuse
+    vec3 lightDir = normalize(lightView - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuse = diff * Color;
+
+    // Specular
+    float specularStrength = 0.3;
+    vec3 viewDir = normalize(-FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+    vec3 specular = specularStrength * spec * vec3(1.0);
+
+    // Ambient occlusion darkens ambient and diffuse light alike
+    float occlusionStrength = 0.8;
+    float occlusion = mix(1.0, Ambient, occlusionStrength);
+
+    vec3 result = (ambient + diffuse) * occlusion + specular;
+    FragColor = vec4(result, 1.0);
+}
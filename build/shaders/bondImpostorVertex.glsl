@@ -0,0 +1,69 @@
+#version 330 core
+
+// Box corner: x, y across the cylinder in radii, z along it from atom 0 to atom 1
+layout (location = 0) in vec3 aCorner;
+
+// Instance attribute: the two bonded atoms, as indices into the instance texture buffers
+layout (location = 1) in uvec2 bondAtoms;
+
+// Everything is passed in view space, where the eye sits at the origin
+out vec3 RayPoint;
+flat out vec3 BondStart;
+flat out vec3 BondAxis;
+flat out float BondLength;
+flat out vec3 StartColor;
+flat out vec3 EndColor;
+flat out float StartAmbient;
+flat out float EndAmbient;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float bondRadius;
+uniform samplerBuffer palette;
+uniform samplerBuffer instancePositions;
+uniform usamplerBuffer instanceAppearance;
+
+vec3 atomPosition(int id)
+{
+    return vec3(texelFetch(instancePositions, id * 3).r,
+                texelFetch(instancePositions, id * 3 + 1).r,
+                texelFetch(instancePositions, id * 3 + 2).r);
+}
+
+vec3 atomColor(int id)
+{
+    uint colorIndex = texelFetch(instanceAppearance, id * 2 + 1).r & 0xFFu;
+    return texelFetch(palette, int(colorIndex)).rgb;
+}
+
+float atomAmbient(int id)
+{
+    return float((texelFetch(instanceAppearance, id * 2 + 1).r >> 8) & 0xFFu) / 255.0;
+}
+
+void main()
+{
+    int first = int(bondAtoms.x);
+    int second = int(bondAtoms.y);
+    vec3 start = vec3(view * vec4(atomPosition(first), 1.0));
+    vec3 end = vec3(view * vec4(atomPosition(second), 1.0));
+
+    // Right-handed frame around the axis, so the box keeps its winding
+    vec3 axis = end - start;
+    float len = max(length(axis), 1e-6);
+    vec3 dir = axis / len;
+    vec3 helper = abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 across = normalize(cross(helper, dir));
+    vec3 up = cross(dir, across);
+
+    RayPoint = start + axis * aCorner.z + (across * aCorner.x + up * aCorner.y) * bondRadius;
+    BondStart = start;
+    BondAxis = dir;
+    BondLength = len;
+    StartColor = atomColor(first);
+    EndColor = atomColor(second);
+    StartAmbient = atomAmbient(first);
+    EndAmbient = atomAmbient(second);
+
+    gl_Position = projection * vec4(RayPoint, 1.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// One level of the max-depth pyramid: each texel keeps the farthest depth of the source
+// texels it covers
+
+out float MaxDepth;
+
+// Only the source level is sampleable (base level = max level), so it is always lod 0
+uniform sampler2D source;
+
+void main()
+{
+    ivec2 sourceSize = textureSize(source, 0);
+    ivec2 size = max(sourceSize / 2, ivec2(1));
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 base = texel * 2;
+
+    // An odd source row or column would fall between footprints; the last texel takes it in
+    ivec2 footprint = ivec2(2);
+    if (texel.x == size.x - 1 && (sourceSize.x & 1) != 0)
+        footprint.x = 3;
+    if (texel.y == size.y - 1 && (sourceSize.y & 1) != 0)
+        footprint.y = 3;
+
+    float depth = 0.0;
+    for (int y = 0; y < footprint.y; ++y) {
+        for (int x = 0; x < footprint.x; ++x)
+            depth = max(depth, texelFetch(source, min(base + ivec2(x, y), sourceSize - 1), 0).r);
+    }
+    MaxDepth = depth;
+}
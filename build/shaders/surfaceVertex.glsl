@@ -0,0 +1,24 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec4 aColor;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+out float Ambient;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    // Surface vertices are already in world space
+    FragPos = aPos;
+    Normal = aNormal;
+    Color = aColor.rgb;
+    Ambient = 1.0;
+
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
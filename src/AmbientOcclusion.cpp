@@ -0,0 +1,158 @@
+#include "AmbientOcclusion.h"
+#include "SpatialIndex.h"
+#include "SpherePoints.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AMBIENT_SSE 1
+#endif
+
+// Atoms per parallel task
+static const size_t atomBlockSize = 1024;
+
+// Unit directions as structure-of-arrays, padded to a multiple of four so one occluder is
+// tested against four directions per step. Padding directions are zero vectors; what they
+// collect is never read.
+struct DirectionSet {
+    std::vector<float> x, y, z;
+
+    explicit DirectionSet(int count) {
+        std::vector<glm::vec3> directions = spherePoints(count);
+        directions.resize((directions.size() + 3) / 4 * 4, glm::vec3(0.0f));
+        for (const glm::vec3& d : directions) {
+            x.push_back(d.x);
+            y.push_back(d.y);
+            z.push_back(d.z);
+        }
+    }
+    size_t size() const { return x.size(); }
+};
+
+// Shortens nearest[k], the free distance along direction k from the point of the atom's
+// sphere facing it, to where that ray enters the occluder at `offset` from the atom's
+// center. The ray runs along the line from the center, so only the part of the line past
+// `radius` counts; a ray starting inside the occluder is blocked at once.
+static void occlude(const DirectionSet& directions, const glm::vec3& offset, float occluderRadius, float radius,
+                    float* nearest) {
+    const float distanceSquared = glm::dot(offset, offset);
+    const float radiusSquared = occluderRadius * occluderRadius;
+    const size_t n = directions.size();
+#ifdef AMBIENT_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 ox = _mm_set1_ps(offset.x);
+    const __m128 oy = _mm_set1_ps(offset.y);
+    const __m128 oz = _mm_set1_ps(offset.z);
+    const __m128 start = _mm_set1_ps(radius);
+    const __m128 missDistance = _mm_set1_ps(distanceSquared - radiusSquared);
+    for (size_t k = 0; k < n; k += 4) {
+        __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&directions.x[k]), ox),
+                                             _mm_mul_ps(_mm_loadu_ps(&directions.y[k]), oy)),
+                                  _mm_mul_ps(_mm_loadu_ps(&directions.z[k]), oz));
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(along, along), missDistance);
+        __m128 halfChord = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+        __m128 enter = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(along, halfChord), start), zero);
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_cmpgt_ps(_mm_add_ps(along, halfChord), start));
+        __m128 current = _mm_loadu_ps(nearest + k);
+        __m128 shortened = _mm_min_ps(current, enter);
+        _mm_storeu_ps(nearest + k, _mm_or_ps(_mm_and_ps(hit, shortened), _mm_andnot_ps(hit, current)));
+    }
+#else
+    for (size_t k = 0; k < n; ++k) {
+        float along = directions.x[k] * offset.x + directions.y[k] * offset.y + directions.z[k] * offset.z;
+        float discriminant = radiusSquared - (distanceSquared - along * along);
+        float halfChord = std::sqrt(std::max(discriminant, 0.0f));
+        float enter = std::max(along - halfChord - radius, 0.0f);
+        bool hit = discriminant >= 0.0f && along + halfChord > radius;
+        nearest[k] = hit ? std::min(nearest[k], enter) : nearest[k];
+    }
+#endif
+}
+
+void computeAmbientOcclusion(const std::vector<SphereInstance>& instances, ThreadPool& pool,
+                             std::vector<float>& ambient, int directionCount, float maxDistance,
+                             const std::atomic<bool>* cancel) {
+    size_t n = instances.size();
+    ambient.assign(n, 1.0f);
+    if (n == 0 || directionCount <= 0)
+        return;
+    float maxRadius = 0.0f;
+    for (const SphereInstance& instance : instances)
+        maxRadius = std::max(maxRadius, instance.radius);
+    DirectionSet directions(directionCount);
+    SpatialIndex index;
+    index.build(instances, maxDistance + 2.0f * maxRadius, pool);
+
+    pool.parallelFor((n + atomBlockSize - 1) / atomBlockSize, [&](size_t b) {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return;
+        std::vector<uint32_t> candidates;
+        std::vector<float> nearest(directions.size());
+        for (size_t i = b * atomBlockSize; i < std::min(n, (b + 1) * atomBlockSize); ++i) {
+            const glm::vec3 center = instances[i].position;
+            const float radius = instances[i].radius;
+            // Spheres some ray leaving this one can reach within maxDistance
+            candidates.clear();
+            index.radiusQuery(center, radius + maxDistance + maxRadius, candidates);
+            std::fill(nearest.begin(), nearest.end(), maxDistance);
+            for (uint32_t j : candidates) {
+                if (j == i)
+                    continue;
+                glm::vec3 offset = index.position(j) - center;
+                float reach = radius + maxDistance + instances[j].radius;
+                if (glm::dot(offset, offset) < reach * reach)
+                    occlude(directions, offset, instances[j].radius, radius, nearest.data());
+            }
+            float light = 0.0f;
+            for (int k = 0; k < directionCount; ++k)
+                light += nearest[k];
+            // Half of all directions is an open half space
+            ambient[i] = std::min(1.0f, 2.0f * light / (maxDistance * directionCount));
+        }
+    });
+}
+
+AmbientOcclusionJob::~AmbientOcclusionJob() {
+    stop();
+}
+
+void AmbientOcclusionJob::start(const std::vector<SphereInstance>& instances, uint64_t generation) {
+    stop();
+    snapshot = instances;
+    jobGeneration = generation;
+    cancelRequested = false;
+    workerDone = false;
+    worker = std::thread(&AmbientOcclusionJob::run, this);
+}
+
+bool AmbientOcclusionJob::poll(std::vector<uint8_t>& ambient, uint64_t& generation, double& milliseconds) {
+    if (!worker.joinable() || !workerDone.load(std::memory_order_acquire))
+        return false;
+    worker.join();
+    ambient = std::move(result);
+    generation = jobGeneration;
+    milliseconds = elapsedMs;
+    return true;
+}
+
+void AmbientOcclusionJob::stop() {
+    cancelRequested = true;
+    if (worker.joinable())
+        worker.join();
+}
+
+void AmbientOcclusionJob::run() {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<float> light;
+    computeAmbientOcclusion(snapshot, ThreadPool::global(), light, ambientDirectionCount, ambientOcclusionDistance,
+                            &cancelRequested);
+    result.resize(light.size());
+    for (size_t i = 0; i < light.size(); ++i)
+        result[i] = static_cast<uint8_t>(std::lround(light[i] * 255.0f));
+    snapshot.clear();
+    snapshot.shrink_to_fit();
+    elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    workerDone.store(true, std::memory_order_release);
+}
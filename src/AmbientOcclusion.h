@@ -0,0 +1,67 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Sphere.h"
+#include "ThreadPool.h"
+
+// Light directions sampled per atom
+constexpr int ambientDirectionCount = 32;
+// Occluders further than this from an atom's surface cast no shadow on it, in Angstroms
+constexpr float ambientOcclusionDistance = 6.0f;
+
+// Ambient light reaching every sphere, 0 (buried) to 1 (fully exposed), as in QuteMol's
+// per-atom occlusion: for each of a fixed set of directions, the point of the sphere facing
+// that direction receives light unless a ray from it along the direction hits another
+// sphere. A hit at distance t lets through t / maxDistance of the light, so near neighbors
+// shade more than far ones. The light is relative to what an atom in a flat surface gets,
+// an open half space, so exposed atoms reach 1. Neighbors come from a SpatialIndex, each is
+// tested against four directions at a time with SSE where available, and atoms are
+// processed in parallel blocks on `pool`. Uses the instance radii, so the result
+// depends on the atom style. If `cancel` is given and becomes true, the remaining blocks
+// are skipped and the result is incomplete.
+void computeAmbientOcclusion(const std::vector<SphereInstance>& instances, ThreadPool& pool,
+                             std::vector<float>& ambient, int directionCount = ambientDirectionCount,
+                             float maxDistance = ambientOcclusionDistance,
+                             const std::atomic<bool>* cancel = nullptr);
+
+// Computes ambient occlusion on a background thread, so large structures never stall the
+// render thread. A job works on its own copy of the instances and is tagged with a
+// generation number chosen by the caller, which can then drop results that went stale
+// while they were being computed.
+class AmbientOcclusionJob
+{
+public:
+    AmbientOcclusionJob() = default;
+    ~AmbientOcclusionJob();
+
+    AmbientOcclusionJob(const AmbientOcclusionJob&) = delete;
+    AmbientOcclusionJob& operator=(const AmbientOcclusionJob&) = delete;
+
+    // Starts a job for a copy of `instances`, cancelling and waiting for a running one
+    void start(const std::vector<SphereInstance>& instances, uint64_t generation);
+    // Render thread: once a job has finished, moves its light per instance (0-255) into
+    // `ambient` and returns true with its generation and run time; false while running
+    bool poll(std::vector<uint8_t>& ambient, uint64_t& generation, double& milliseconds);
+    // Cancels a running job and waits for its thread to exit
+    void stop();
+
+    bool busy() const { return worker.joinable(); }
+
+private:
+    void run();
+
+    std::thread worker;
+    std::vector<SphereInstance> snapshot;
+    std::vector<uint8_t> result;
+    uint64_t jobGeneration = 0;
+    // Written by the worker before workerDone is set
+    double elapsedMs = 0.0;
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<bool> workerDone{false};
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include "AsyncLoader.h"
+#include "MappedFile.h"
+#include "PDBParser.h"
+#include "CIFParser.h"
+#include "GzipStream.h"
+#include "StructureCache.h"
+#include "Bonds.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+// Bytes of PDB text per batch; small enough that the first atoms show up almost at once
+static const size_t batchBytes = 2u << 20;
+// Atoms per batch when streaming a cached structure to the render thread
+static const size_t cachedBatchAtoms = 1u << 17;
+
+AsyncLoader::~AsyncLoader() {
+    stop();
+}
+
+void AsyncLoader::stop() {
+    cancel();
+    if (worker.joinable())
+        worker.join();
+    currentPhase = Phase::Idle;
+}
+
+void AsyncLoader::start(const std::string& path, bool useCache, Prepare prepare) {
+    if (worker.joinable()) {
+        cancel();
+        worker.join();
+    }
+    std::shared_ptr<const Structure> stale;
+    while (batches.pop(stale)) {}
+
+    filePath = path;
+    prepareLoaded = std::move(prepare);
+    loadedStructure.clear();
+    loadedTrajectory.clear();
+    cancelRequested = false;
+    workerDone = false;
+    outcome = Result::Pending;
+    currentPhase = useCache ? Phase::Hashing : Phase::Parsing;
+    progressFraction = 0.0f;
+    fromCache = false;
+    elapsedMs = 0.0;
+    bondMs = 0.0;
+    bondsCached = false;
+    worker = std::thread(&AsyncLoader::run, this, useCache);
+}
+
+void AsyncLoader::cancel() {
+    cancelRequested = true;
+}
+
+AsyncLoader::Result AsyncLoader::poll(const std::function<void(const Structure&)>& consume, size_t maxBatches) {
+    if (!worker.joinable())
+        return Result::Pending;
+
+    // Read the done flag first: every batch was queued before it was set
+    bool done = workerDone.load(std::memory_order_acquire);
+    std::shared_ptr<const Structure> batch;
+    size_t consumed = 0;
+    while ((cancelRequested || consumed < maxBatches) && batches.pop(batch)) {
+        if (!cancelRequested) {
+            consume(*batch);
+            ++consumed;
+        }
+    }
+    if (!done || !batches.empty())
+        return Result::Pending;
+
+    worker.join();
+    currentPhase = Phase::Idle;
+    return cancelRequested ? Result::Cancelled : outcome.load();
+}
+
+void AsyncLoader::takeLoaded(Structure& structure, Trajectory& trajectory) {
+    structure = std::move(loadedStructure);
+    trajectory = std::move(loadedTrajectory);
+    loadedStructure.clear();
+    loadedTrajectory.clear();
+}
+
+const char* AsyncLoader::phaseName() const {
+    switch (currentPhase.load()) {
+        case Phase::Hashing:      return "Hashing";
+        case Phase::ReadingCache: return "Reading cache";
+        case Phase::Parsing:      return "Parsing";
+        case Phase::WritingCache: return "Writing cache";
+        case Phase::Preparing:    return "Preparing";
+        default:                  return "Idle";
+    }
+}
+
+bool AsyncLoader::pushBatch(std::shared_ptr<const Structure> batch) {
+    while (!batches.push(std::move(batch))) {
+        if (cancelRequested)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+void AsyncLoader::run(bool useCache) {
+    auto start = std::chrono::steady_clock::now();
+    auto finish = [&](Result result) {
+        elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        outcome = result;
+        workerDone.store(true, std::memory_order_release);
+    };
+
+    MappedFile file(filePath);
+    if (!file.is_open()) {
+        finish(Result::Failed);
+        return;
+    }
+    ThreadPool& pool = ThreadPool::global();
+
+    std::vector<std::shared_ptr<const Structure>> parts;
+    // The hash only identifies cache entries; without the cache parsing starts at once
+    uint64_t contentHash = 0;
+    if (useCache) {
+        currentPhase = Phase::Hashing;
+        contentHash = StructureCache::hashContent(file.view(), pool);
+        currentPhase = Phase::ReadingCache;
+        Structure cached;
+        if (StructureCache::load(filePath, file.size(), contentHash, cached)) {
+            fromCache = true;
+            for (size_t first = 0; first < cached.size(); first += cachedBatchAtoms) {
+                size_t n = std::min(cachedBatchAtoms, cached.size() - first);
+                // Slices are only for display; the structure is assembled from `cached` itself
+                if (!pushBatch(std::make_shared<Structure>(cached.slice(first, n)))) {
+                    finish(Result::Cancelled);
+                    return;
+                }
+                progressFraction = static_cast<float>(first + n) / cached.size();
+            }
+            progressFraction = 1.0f;
+            finish(assemble(cached));
+            return;
+        }
+    }
+
+    currentPhase = Phase::Parsing;
+
+    if (isGzipData(file.view())) {
+        Result result = parseCompressed(file.view(), parts);
+        if (result == Result::Finished)
+            result = assemble(parts, useCache, file.size(), contentHash);
+        finish(result);
+        return;
+    }
+
+    // mmCIF is read in one streaming pass; batches are queued as the reader goes
+    if (isCIFFile(filePath, file.view())) {
+        Structure pending;
+        parseCIFAtoms(file.view(), pending, [&](Structure& atoms, size_t bytesRead) {
+            auto batch = std::make_shared<Structure>(std::move(atoms));
+            parts.push_back(batch);
+            progressFraction = file.size() > 0 ? static_cast<float>(bytesRead) / file.size() : 1.0f;
+            return !cancelRequested && pushBatch(batch);
+        });
+        if (cancelRequested) {
+            finish(Result::Cancelled);
+            return;
+        }
+        finish(assemble(parts, useCache, file.size(), contentHash));
+        return;
+    }
+
+    // Parse one wave of chunks in parallel, queue them in order, repeat
+    std::vector<std::string_view> chunks = splitPDBText(file.view(), file.size() / batchBytes + 1);
+    size_t bytesParsed = 0;
+    for (size_t wave = 0; wave < chunks.size(); wave += pool.size()) {
+        if (cancelRequested) {
+            finish(Result::Cancelled);
+            return;
+        }
+        size_t waveSize = std::min<size_t>(pool.size(), chunks.size() - wave);
+        std::vector<std::shared_ptr<Structure>> parsed(waveSize);
+        pool.parallelFor(waveSize, [&](size_t i) {
+            parsed[i] = std::make_shared<Structure>();
+            parsePDBAtoms(chunks[wave + i], *parsed[i]);
+            parsed[i]->shrinkToFit();
+        });
+        for (size_t i = 0; i < waveSize; ++i) {
+            bytesParsed += chunks[wave + i].size();
+            parts.push_back(parsed[i]);
+            if (!pushBatch(parsed[i])) {
+                finish(Result::Cancelled);
+                return;
+            }
+        }
+        progressFraction = file.size() > 0 ? static_cast<float>(bytesParsed) / file.size() : 1.0f;
+    }
+
+    finish(assemble(parts, useCache, file.size(), contentHash));
+}
+
+AsyncLoader::Result AsyncLoader::assemble(std::vector<std::shared_ptr<const Structure>>& parts, bool useCache,
+                                          uint64_t sourceSize, uint64_t contentHash) {
+    if (cancelRequested)
+        return Result::Cancelled;
+    currentPhase = Phase::Preparing;
+    // Without MODEL records the assembled structure is the whole file, and the cache is
+    // written from it. Later models are only kept as coordinates, so their batches stay
+    // alive until the cache is written.
+    bool keepParts = useCache && std::any_of(parts.begin(), parts.end(),
+                                             [](const auto& part) { return !part->models.empty(); });
+    for (auto& part : parts) {
+        loadedTrajectory.addBatch(*part, loadedStructure);
+        if (!keepParts)
+            part.reset();
+    }
+    loadedStructure.shrinkToFit();
+    perceiveLoadedBonds();
+    if (cancelRequested)
+        return Result::Cancelled;
+
+    std::vector<const Structure*> views;
+    if (keepParts) {
+        for (const auto& part : parts)
+            views.push_back(part.get());
+    } else {
+        views.push_back(&loadedStructure);
+    }
+    writeCache(useCache, sourceSize, contentHash, views);
+    parts.clear();
+    return prepare();
+}
+
+AsyncLoader::Result AsyncLoader::assemble(Structure& whole) {
+    if (cancelRequested)
+        return Result::Cancelled;
+    currentPhase = Phase::Preparing;
+    // Without MODEL records the cached atoms are the topology as they are
+    if (whole.models.empty()) {
+        loadedStructure = std::move(whole);
+    } else {
+        loadedTrajectory.addBatch(whole, loadedStructure);
+        // Cached bonds cover the first model, which is what the topology holds
+        loadedStructure.bondOffsets.swap(whole.bondOffsets);
+        loadedStructure.bondNeighbors.swap(whole.bondNeighbors);
+    }
+    whole.clear();
+    perceiveLoadedBonds();
+    return prepare();
+}
+
+void AsyncLoader::perceiveLoadedBonds() {
+    if (loadedStructure.bondOffsets.size() == loadedStructure.size() + 1) {
+        bondsCached = true;
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    perceiveBonds(loadedStructure, ThreadPool::global());
+    bondMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+AsyncLoader::Result AsyncLoader::prepare() {
+    if (cancelRequested)
+        return Result::Cancelled;
+    currentPhase = Phase::Preparing;
+    if (prepareLoaded)
+        prepareLoaded(loadedStructure, loadedTrajectory);
+    return cancelRequested ? Result::Cancelled : Result::Finished;
+}
+
+AsyncLoader::Result AsyncLoader::parseCompressed(std::string_view compressed,
+                                                 std::vector<std::shared_ptr<const Structure>>& parts) {
+    GzipStream stream;
+    stream.start(compressed);
+
+    // Decompressed text accumulates here until a batch is worth parsing; whatever the
+    // parser leaves (a partial line or row) is carried to the front of the next batch
+    std::string pending;
+    pending.reserve(batchBytes + GzipStream::blockSize);
+    CIFAtomReader cifReader;
+    bool formatKnown = false;
+    bool cif = false;
+
+    std::string_view block;
+    bool more = true;
+    while (more) {
+        more = stream.next(block);
+        if (cancelRequested)
+            return Result::Cancelled;
+        if (more) {
+            pending.append(block);
+            if (pending.size() < batchBytes)
+                continue;
+        }
+
+        if (!formatKnown) {
+            cif = isCIFFile(stripGzipExtension(filePath), pending);
+            formatKnown = true;
+        }
+        auto batch = std::make_shared<Structure>();
+        size_t consumed;
+        if (cif) {
+            consumed = cifReader.feed(pending, *batch, !more);
+        } else {
+            size_t lastNewline = pending.rfind('\n');
+            consumed = !more ? pending.size() : (lastNewline == std::string::npos ? 0 : lastNewline + 1);
+            parsePDBAtoms(std::string_view(pending).substr(0, consumed), *batch);
+        }
+        pending.erase(0, consumed);
+
+        progressFraction = compressed.size() > 0 ? static_cast<float>(stream.bytesRead()) / compressed.size() : 1.0f;
+        // A batch can hold only CONECT, HELIX, SHEET or MODEL records, e.g. the tail of a
+        // PDB file after the last atom line; those must be assembled as well
+        if (batch->empty() && batch->conect.empty() && batch->secondary.empty() && batch->models.empty())
+            continue;
+        batch->shrinkToFit();
+        parts.push_back(batch);
+        if (!pushBatch(batch))
+            return Result::Cancelled;
+    }
+    return stream.failed() ? Result::Failed : Result::Finished;
+}
+
+void AsyncLoader::writeCache(bool useCache, uint64_t sourceSize, uint64_t contentHash,
+                             const std::vector<const Structure*>& parts) {
+    if (!useCache)
+        return;
+    currentPhase = Phase::WritingCache;
+    StructureCache::save(filePath, sourceSize, contentHash, parts, &loadedStructure);
+}
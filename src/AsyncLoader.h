@@ -0,0 +1,104 @@
+#ifndef ASYNC_LOADER_H
+#define ASYNC_LOADER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include "Structure.h"
+#include "Trajectory.h"
+#include "SPSCQueue.h"
+
+// Loads a structure file on a background thread. Parsed atoms are handed to the render
+// thread in file-order batches through a lock-free queue, so the structure appears
+// progressively while the rest of the file streams in. Once parsing is done the worker
+// also assembles the complete structure and runs the caller's whole-structure work on it,
+// so finishing a load costs the render thread no more than swapping the result in. The
+// assembled structure is the only full copy: the batches are meant for display and are
+// released as they are consumed.
+class AsyncLoader
+{
+public:
+    enum class Phase { Idle, Hashing, ReadingCache, Parsing, WritingCache, Preparing };
+    enum class Result { Pending, Finished, Cancelled, Failed };
+    // Runs on the loader thread on the complete structure and its trajectory frames,
+    // before the load reports Finished (e.g. atom ordering). Bonds are already perceived,
+    // or read from the cache.
+    using Prepare = std::function<void(Structure& structure, Trajectory& trajectory)>;
+
+    AsyncLoader() = default;
+    ~AsyncLoader();
+
+    AsyncLoader(const AsyncLoader&) = delete;
+    AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+    // Starts loading `path`, cancelling any load still in flight
+    void start(const std::string& path, bool useCache, Prepare prepare = {});
+    // Asks the worker to stop; poll() reports Cancelled once it has
+    void cancel();
+
+    // Render thread: passes up to `maxBatches` parsed batches to `consume`, in file order,
+    // so one frame never absorbs more than a bounded amount of work. Returns the outcome
+    // once the load has ended and every batch was consumed (reported exactly once),
+    // Pending otherwise.
+    Result poll(const std::function<void(const Structure&)>& consume, size_t maxBatches = 4);
+    // Cancels and waits for the worker thread to exit
+    void stop();
+    // Once poll() has reported Finished: moves out the complete structure, after `prepare`,
+    // and its frames. They replace what the batches built up on the render thread.
+    void takeLoaded(Structure& structure, Trajectory& trajectory);
+
+    bool busy() const { return worker.joinable(); }
+    float progress() const { return progressFraction.load(); }
+    Phase phase() const { return currentPhase.load(); }
+    const char* phaseName() const;
+    const std::string& path() const { return filePath; }
+    bool loadedFromCache() const { return fromCache.load(); }
+    double elapsedMilliseconds() const { return elapsedMs.load(); }
+    // Bond perception time of the last load; 0 when the bonds came from the cache
+    double bondMilliseconds() const { return bondMs.load(); }
+    bool bondsFromCache() const { return bondsCached.load(); }
+
+private:
+    void run(bool useCache);
+    // Blocks while the queue is full; false if the load was cancelled meanwhile
+    bool pushBatch(std::shared_ptr<const Structure> batch);
+    // Parses gzip-compressed PDB or mmCIF text while it is being inflated
+    Result parseCompressed(std::string_view compressed, std::vector<std::shared_ptr<const Structure>>& parts);
+    // Saves `parts` with the bonds of the assembled structure
+    void writeCache(bool useCache, uint64_t sourceSize, uint64_t contentHash, const std::vector<const Structure*>& parts);
+    // Builds the complete structure from every batch, releasing each one as it is added,
+    // perceives its bonds, writes the cache if `useCache`, and runs `prepare` on it;
+    // Cancelled if the load was cancelled meanwhile
+    Result assemble(std::vector<std::shared_ptr<const Structure>>& parts, bool useCache, uint64_t sourceSize,
+                    uint64_t contentHash);
+    // The same for a structure read whole from the cache, which is moved in
+    Result assemble(Structure& whole);
+    // Perceives the bonds of the assembled structure unless it already has them
+    void perceiveLoadedBonds();
+    // Runs the caller's `prepare` on the assembled structure
+    Result prepare();
+
+    std::thread worker;
+    std::string filePath;
+    SPSCQueue<std::shared_ptr<const Structure>, 256> batches;
+    Prepare prepareLoaded;
+    Structure loadedStructure;
+    Trajectory loadedTrajectory;
+
+    std::atomic<bool> cancelRequested{false};
+    std::atomic<bool> workerDone{false};
+    std::atomic<Result> outcome{Result::Pending};
+    std::atomic<Phase> currentPhase{Phase::Idle};
+    std::atomic<float> progressFraction{0.0f};
+    std::atomic<bool> fromCache{false};
+    std::atomic<double> elapsedMs{0.0};
+    std::atomic<double> bondMs{0.0};
+    std::atomic<bool> bondsCached{false};
+};
+
+#endif
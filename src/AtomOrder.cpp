@@ -0,0 +1,153 @@
+#include "AtomOrder.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+// Bits per axis of the curve; 2^10 steps across the bounding box
+static const int curveBits = 10;
+// Consecutive segments of a chain are sorted as one segment of about this many atoms,
+// so most backbone bonds still join neighboring atoms
+static const uint32_t segmentAtoms = 64;
+
+// Position of a grid point along a 3D Hilbert curve (Skilling's transpose method)
+static uint32_t hilbertIndex(uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t axes[3] = {x, y, z};
+    // Inverse undo
+    for (uint32_t q = 1u << (curveBits - 1); q > 1; q >>= 1) {
+        uint32_t p = q - 1;
+        for (int i = 0; i < 3; ++i) {
+            if (axes[i] & q) {
+                axes[0] ^= p;
+            } else {
+                uint32_t t = (axes[0] ^ axes[i]) & p;
+                axes[0] ^= t;
+                axes[i] ^= t;
+            }
+        }
+    }
+    // Gray encode
+    axes[1] ^= axes[0];
+    axes[2] ^= axes[1];
+    uint32_t t = 0;
+    for (uint32_t q = 1u << (curveBits - 1); q > 1; q >>= 1) {
+        if (axes[2] & q)
+            t ^= q - 1;
+    }
+    for (int i = 0; i < 3; ++i)
+        axes[i] ^= t;
+    // Interleave the transposed bits, most significant first
+    uint32_t index = 0;
+    for (int b = curveBits - 1; b >= 0; --b) {
+        for (int i = 0; i < 3; ++i)
+            index = (index << 1) | ((axes[i] >> b) & 1);
+    }
+    return index;
+}
+
+std::vector<uint32_t> spatialOrder(const Structure& structure) {
+    size_t n = structure.size();
+    std::vector<uint32_t> order(n);
+    if (n == 0)
+        return order;
+
+    // Atoms are moved in segments that are never split: a residue always stays whole, and
+    // consecutive polymer residues of one chain share a segment until it holds
+    // segmentAtoms atoms. Hetero residues form segments of their own.
+    struct Segment {
+        uint32_t first;
+        uint32_t count;
+        uint32_t code;
+    };
+    std::vector<Segment> segments;
+    std::vector<glm::vec3> centroids;
+    for (size_t i = 0; i < n; ++i) {
+        bool sameResidue = i > 0 && structure.sameResidue(i, i - 1);
+        bool samePolymer = i > 0 && !structure.hetero[i] && !structure.hetero[i - 1] &&
+                           structure.chain[i] == structure.chain[i - 1];
+        bool sameSegment = sameResidue || (samePolymer && segments.back().count < segmentAtoms);
+        if (sameSegment) {
+            ++segments.back().count;
+            centroids.back() += structure.position(i);
+        } else {
+            segments.push_back({static_cast<uint32_t>(i), 1, 0});
+            centroids.push_back(structure.position(i));
+        }
+    }
+
+    glm::vec3 low(std::numeric_limits<float>::max());
+    glm::vec3 high(std::numeric_limits<float>::lowest());
+    for (size_t g = 0; g < segments.size(); ++g) {
+        centroids[g] /= static_cast<float>(segments[g].count);
+        low = glm::min(low, centroids[g]);
+        high = glm::max(high, centroids[g]);
+    }
+    // A common scale for all axes keeps the curve's cells cubic
+    const float steps = static_cast<float>((1 << curveBits) - 1);
+    float extent = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1e-3f));
+    float scale = steps / extent;
+    for (size_t g = 0; g < segments.size(); ++g) {
+        glm::vec3 q = glm::clamp((centroids[g] - low) * scale, glm::vec3(0.0f), glm::vec3(steps));
+        segments[g].code = hilbertIndex(static_cast<uint32_t>(q.x), static_cast<uint32_t>(q.y), static_cast<uint32_t>(q.z));
+    }
+    // Stable, so segments sharing a cell keep file order
+    std::stable_sort(segments.begin(), segments.end(),
+                     [](const Segment& a, const Segment& b) { return a.code < b.code; });
+
+    size_t write = 0;
+    for (const Segment& segment : segments) {
+        for (uint32_t k = 0; k < segment.count; ++k)
+            order[write++] = segment.first + k;
+    }
+    return order;
+}
+
+void reorderAtoms(Structure& structure, const std::vector<uint32_t>& order, ThreadPool& pool) {
+    size_t n = structure.size();
+    if (order.size() != n)
+        return;
+
+    // Every column is gathered on its own task
+    std::vector<std::function<void()>> gathers;
+    Structure::forEachColumn([&](auto& column) {
+        gathers.push_back([&column, &order, n] {
+            std::remove_reference_t<decltype(column)> sorted(n);
+            for (size_t i = 0; i < n; ++i)
+                sorted[i] = column[order[i]];
+            column.swap(sorted);
+        });
+    }, structure);
+    pool.parallelFor(gathers.size(), [&](size_t c) { gathers[c](); });
+
+    std::vector<uint32_t> fileOrder(n);
+    for (size_t i = 0; i < n; ++i)
+        fileOrder[i] = static_cast<uint32_t>(structure.fileIndex(order[i]));
+    structure.fileOrder.swap(fileOrder);
+
+    if (structure.bondOffsets.size() == n + 1) {
+        std::vector<uint32_t> newIndex(n);
+        for (size_t i = 0; i < n; ++i)
+            newIndex[order[i]] = static_cast<uint32_t>(i);
+        std::vector<uint32_t> offsets(n + 1, 0);
+        std::vector<uint32_t> neighbors(structure.bondNeighbors.size());
+        for (size_t i = 0; i < n; ++i)
+            offsets[i + 1] = offsets[i] + (structure.bondOffsets[order[i] + 1] - structure.bondOffsets[order[i]]);
+        for (size_t i = 0; i < n; ++i) {
+            auto first = neighbors.begin() + offsets[i];
+            for (uint32_t k = structure.bondOffsets[order[i]]; k < structure.bondOffsets[order[i] + 1]; ++k)
+                *first++ = newIndex[structure.bondNeighbors[k]];
+            std::sort(neighbors.begin() + offsets[i], first);
+        }
+        structure.bondOffsets.swap(offsets);
+        structure.bondNeighbors.swap(neighbors);
+    }
+}
+
+std::vector<uint32_t> fileOrderOf(const Structure& structure) {
+    std::vector<uint32_t> order(structure.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[structure.fileIndex(i)] = static_cast<uint32_t>(i);
+    return order;
+}
@@ -0,0 +1,25 @@
+#ifndef ATOM_ORDER_H
+#define ATOM_ORDER_H
+
+#include <cstdint>
+#include <vector>
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Atom order along a Hilbert curve through the structure's bounding box, so atoms close in
+// space are close in memory and in the instance buffers. Atoms move in segments: runs of
+// whole consecutive residues of one chain, about 64 atoms long, keep their file order
+// (and with it most backbone bonds between neighboring atoms), and segments are ordered by
+// the curve position of their centroid. Residue clusters (ClusterBVH.h) stay intact.
+// Returns the permutation for reorderAtoms(): atom i of the result is atom order[i].
+std::vector<uint32_t> spatialOrder(const Structure& structure);
+
+// Moves every atom of `structure` to its place in `order` (new index -> current index).
+// Bonds, if perceived, are renumbered, and fileOrder keeps track of where each atom came
+// from, so reordering twice still maps back to the file.
+void reorderAtoms(Structure& structure, const std::vector<uint32_t>& order, ThreadPool& pool);
+
+// The order that puts a reordered structure back into file order
+std::vector<uint32_t> fileOrderOf(const Structure& structure);
+
+#endif
@@ -0,0 +1,111 @@
+#include "BondBuffer.h"
+#include <algorithm>
+#include <iterator>
+
+BondBuffer::~BondBuffer() {
+    release();
+}
+
+void BondBuffer::upload(const Structure& structure) {
+    size_t atoms = structure.bondOffsets.empty() ? 0 : structure.bondOffsets.size() - 1;
+    std::vector<uint32_t> pairs;
+    pairs.reserve(structure.bondNeighbors.size());
+    firstBond.assign(atoms + 1, 0);
+    for (size_t i = 0; i < atoms; ++i) {
+        firstBond[i] = static_cast<uint32_t>(pairs.size() / 2);
+        // Every bond is listed at both atoms; keep it once, from its lower atom
+        for (uint32_t k = structure.bondOffsets[i]; k < structure.bondOffsets[i + 1]; ++k) {
+            uint32_t j = structure.bondNeighbors[k];
+            if (j > i) {
+                pairs.push_back(static_cast<uint32_t>(i));
+                pairs.push_back(j);
+            }
+        }
+    }
+    count = pairs.size() / 2;
+    firstBond[atoms] = static_cast<uint32_t>(count);
+
+    upperAtom.resize(count);
+    longBonds.clear();
+    for (size_t b = 0; b < count; ++b) {
+        upperAtom[b] = pairs[2 * b + 1];
+        if (pairs[2 * b + 1] - pairs[2 * b] > shortBondSpan)
+            longBonds.emplace_back(pairs[2 * b + 1], pairs[2 * b]);
+    }
+    std::sort(longBonds.begin(), longBonds.end());
+
+    if (VBO == 0)
+        glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, pairs.size() * sizeof(uint32_t), pairs.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ++allocGeneration;
+}
+
+void BondBuffer::clear() {
+    count = 0;
+    firstBond.clear();
+    upperAtom.clear();
+    longBonds.clear();
+}
+
+void BondBuffer::release() {
+    clear();
+    if (VBO != 0) {
+        glDeleteBuffers(1, &VBO);
+        VBO = 0;
+        ++allocGeneration;
+    }
+}
+
+InstanceRange BondBuffer::bondsOf(const InstanceRange& atoms) const {
+    if (firstBond.empty())
+        return {0, 0};
+    size_t last = firstBond.size() - 1;
+    uint32_t begin = firstBond[std::min<size_t>(atoms.first, last)];
+    uint32_t end = firstBond[std::min<size_t>(static_cast<size_t>(atoms.first) + atoms.count, last)];
+    return {begin, end - begin};
+}
+
+void BondBuffer::edgeBonds(const std::vector<InstanceRange>& atomRanges, std::vector<uint32_t>& pairs) const {
+    size_t atoms = atomCount();
+    // Ranges are sorted: an atom is visible if the last range starting at or before it covers it
+    auto visible = [&](uint32_t i) {
+        auto next = std::upper_bound(atomRanges.begin(), atomRanges.end(), i,
+                                     [](uint32_t atom, const InstanceRange& range) { return atom < range.first; });
+        return next != atomRanges.begin() && i - std::prev(next)->first < std::prev(next)->count;
+    };
+    auto add = [&](uint32_t lower, uint32_t upper) {
+        if (!visible(lower)) {
+            pairs.push_back(lower);
+            pairs.push_back(upper);
+        }
+    };
+    for (const InstanceRange& range : atomRanges) {
+        uint32_t first = static_cast<uint32_t>(std::min<size_t>(range.first, atoms));
+        uint32_t end = static_cast<uint32_t>(std::min<size_t>(static_cast<size_t>(range.first) + range.count, atoms));
+        if (first >= end)
+            continue;
+        // Short bonds into the range start at most shortBondSpan atoms before it
+        for (uint32_t lower = first > shortBondSpan ? first - shortBondSpan : 0; lower < first; ++lower) {
+            for (uint32_t b = firstBond[lower]; b < firstBond[lower + 1]; ++b) {
+                uint32_t upper = upperAtom[b];
+                if (upper >= first && upper < end && upper - lower <= shortBondSpan)
+                    add(lower, upper);
+            }
+        }
+        auto k = std::lower_bound(longBonds.begin(), longBonds.end(), std::make_pair(first, 0u));
+        for (; k != longBonds.end() && k->first < end; ++k) {
+            if (k->second < first)
+                add(k->second, k->first);
+        }
+    }
+}
+
+void BondBuffer::bindAttributes(size_t first) const {
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (void*)(first * 2 * sizeof(uint32_t)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
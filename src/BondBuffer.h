@@ -0,0 +1,64 @@
+#ifndef BOND_BUFFER_H
+#define BOND_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Structure.h"
+#include "InstanceBuffer.h"
+
+// GPU list of the structure's bonds, one pair of atom (instance) indices per bond, ordered
+// by the lower index. Bonds hold no coordinates: shaders look both ends up in the instance
+// position buffer, so trajectory frames and other coordinate changes never touch this
+// buffer.
+class BondBuffer {
+public:
+    BondBuffer() = default;
+    ~BondBuffer();
+
+    BondBuffer(const BondBuffer&) = delete;
+    BondBuffer& operator=(const BondBuffer&) = delete;
+
+    // Uploads the bonds perceived for `structure` (see Bonds.h)
+    void upload(const Structure& structure);
+    void clear();
+    // Deletes the GL buffer as well; must run while the context is current
+    void release();
+
+    // Bonds whose lower atom lies in the given instance range; since bonds are ordered by
+    // that atom, this is itself a contiguous range
+    InstanceRange bondsOf(const InstanceRange& atoms) const;
+    // Appends the index pairs of bonds that bondsOf() misses for a set of visible ranges
+    // (sorted, disjoint): those whose upper atom is in a range but whose lower atom is in
+    // none, e.g. a peptide bond whose lower atom's cluster was culled. Bonds spanning up to
+    // shortBondSpan atoms are found next to each range start; longer ones (disulfides,
+    // CONECT records) through a second index keyed by the upper atom.
+    void edgeBonds(const std::vector<InstanceRange>& atomRanges, std::vector<uint32_t>& pairs) const;
+
+    // Points integer attribute 1 of the currently bound VAO at the index pairs, starting
+    // at bond `first`
+    void bindAttributes(size_t first = 0) const;
+
+    size_t size() const { return count; }
+    // Number of atoms the bonds were uploaded for
+    size_t atomCount() const { return firstBond.empty() ? 0 : firstBond.size() - 1; }
+    // Bumped every time the GL buffer is reallocated, so VAOs know to re-bind attributes
+    unsigned int generation() const { return allocGeneration; }
+
+    static constexpr uint32_t shortBondSpan = 64;
+
+private:
+    GLuint VBO = 0;
+    size_t count = 0;
+    unsigned int allocGeneration = 0;
+    // firstBond[i] is the index of the first bond whose lower atom is i
+    std::vector<uint32_t> firstBond;
+    // Upper atom of every bond, in buffer order
+    std::vector<uint32_t> upperAtom;
+    // Bonds spanning more than shortBondSpan atoms, as (upper, lower) pairs sorted by the upper atom
+    std::vector<std::pair<uint32_t, uint32_t>> longBonds;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "BondImpostor.h"
+#include "BondBuffer.h"
+
+// ---- BondImpostor ----
+BondImpostor::BondImpostor() {
+    // Box as a single triangle strip, wound counter-clockwise seen from outside.
+    // x and y run across the cylinder in units of its radius, z along it from the first
+    // atom (0) to the second (1).
+    const float corners[] = {
+         1.0f,  1.0f, 1.0f,
+        -1.0f,  1.0f, 1.0f,
+         1.0f, -1.0f, 1.0f,
+        -1.0f, -1.0f, 1.0f,
+        -1.0f, -1.0f, 0.0f,
+        -1.0f,  1.0f, 1.0f,
+        -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f, 1.0f,
+         1.0f,  1.0f, 0.0f,
+         1.0f, -1.0f, 1.0f,
+         1.0f, -1.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f,
+         1.0f,  1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f,
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &edgeVBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+    // corner
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+BondImpostor::~BondImpostor() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &edgeVBO);
+}
+
+void BondImpostor::drawInstances(const BondBuffer& bondBuffer) {
+    if (bondBuffer.size() == 0)
+        return;
+
+    glBindVertexArray(VAO);
+    if (boundBondGeneration != bondBuffer.generation()) {
+        bondBuffer.bindAttributes();
+        boundBondGeneration = bondBuffer.generation();
+    }
+    glEnable(GL_CULL_FACE);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, bondBuffer.size());
+    glDisable(GL_CULL_FACE);
+    glBindVertexArray(0);
+}
+
+void BondImpostor::drawInstances(const BondBuffer& bondBuffer, const std::vector<InstanceRange>& atomRanges) {
+    lastBondsDrawn = 0;
+    if (bondBuffer.size() == 0)
+        return;
+
+    glBindVertexArray(VAO);
+    glEnable(GL_CULL_FACE);
+    for (const InstanceRange& atoms : atomRanges) {
+        InstanceRange bonds = bondBuffer.bondsOf(atoms);
+        if (bonds.count == 0)
+            continue;
+        bondBuffer.bindAttributes(bonds.first);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, bonds.count);
+        lastBondsDrawn += bonds.count;
+    }
+    edgePairs.clear();
+    bondBuffer.edgeBonds(atomRanges, edgePairs);
+    if (!edgePairs.empty()) {
+        glBindBuffer(GL_ARRAY_BUFFER, edgeVBO);
+        // Orphan the previous list so the upload does not wait for draws still using it
+        glBufferData(GL_ARRAY_BUFFER, edgePairs.size() * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, edgePairs.size() * sizeof(uint32_t), edgePairs.data());
+        glVertexAttribIPointer(1, 2, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, edgePairs.size() / 2);
+        lastBondsDrawn += edgePairs.size() / 2;
+    }
+    glDisable(GL_CULL_FACE);
+    // Attributes no longer point at the start of the buffer
+    boundBondGeneration = 0;
+    glBindVertexArray(0);
+}
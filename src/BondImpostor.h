@@ -0,0 +1,45 @@
+#ifndef BOND_IMPOSTOR_H
+#define BOND_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+class BondBuffer;
+struct InstanceRange;
+
+// Draws every bond as a ray-cast cylinder. Each bond instance is a box around the cylinder
+// (one 14-vertex triangle strip); the vertex shader (bondImpostorVertex.glsl) fetches both
+// atom positions from the instance texture buffers and orients the box, and the fragment
+// shader intersects the view ray with the cylinder, writing its exact normal and depth.
+// The ends are left open: in ball-and-stick and licorice modes the atom spheres cover them.
+// The instance textures must be bound to the units the shader samples before drawing.
+class BondImpostor {
+public:
+    BondImpostor();
+    ~BondImpostor();
+
+    BondImpostor(const BondImpostor&) = delete;
+    BondImpostor& operator=(const BondImpostor&) = delete;
+
+    void drawInstances(const BondBuffer& bondBuffer);
+    // Draws the bonds of the given atom ranges: those whose lower atom is visible, then the
+    // few whose upper atom is visible but lower atom is not, streamed per call
+    void drawInstances(const BondBuffer& bondBuffer, const std::vector<InstanceRange>& atomRanges);
+    // Bonds drawn by the last ranged drawInstances()
+    size_t bondsDrawn() const { return lastBondsDrawn; }
+
+    // Box faces; about half are back faces, culled before rasterization
+    static constexpr unsigned int trianglesPerInstance = 12;
+
+private:
+    GLuint VAO, VBO, edgeVBO;
+    // Index pairs of the bonds reaching into the ranges from culled atoms, rebuilt every draw
+    std::vector<uint32_t> edgePairs;
+    size_t lastBondsDrawn = 0;
+
+    // Generation of the bond buffer whose attributes are bound to VAO
+    unsigned int boundBondGeneration = 0;
+};
+
+#endif
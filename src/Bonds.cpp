@@ -0,0 +1,127 @@
+#include "Bonds.h"
+#include "Elements.h"
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+using BondPair = std::pair<uint32_t, uint32_t>;
+
+static bool mayBond(const Structure& structure, uint32_t a, uint32_t b) {
+    if (structure.element[a] == 1 && structure.element[b] == 1)
+        return false;
+    char altA = structure.altLoc[a];
+    char altB = structure.altLoc[b];
+    return altA == ' ' || altB == ' ' || altA == altB;
+}
+
+// CONECT bonds that have a HETATM end, as atom index pairs
+static void conectBonds(const Structure& structure, std::vector<BondPair>& pairs) {
+    if (structure.conect.empty())
+        return;
+    // Resolve only the serials the records name, in one pass over the atoms; the first
+    // atom wins if serials repeat
+    std::vector<int32_t> named;
+    named.reserve(structure.conect.size() * 2);
+    for (const ConectBond& bond : structure.conect) {
+        named.push_back(bond.from);
+        named.push_back(bond.to);
+    }
+    std::sort(named.begin(), named.end());
+    named.erase(std::unique(named.begin(), named.end()), named.end());
+    const uint32_t unresolved = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> atomOf(named.size(), unresolved);
+    for (size_t i = 0; i < structure.size(); ++i) {
+        auto it = std::lower_bound(named.begin(), named.end(), structure.serial[i]);
+        if (it != named.end() && *it == structure.serial[i] && atomOf[it - named.begin()] == unresolved)
+            atomOf[it - named.begin()] = static_cast<uint32_t>(i);
+    }
+    auto find = [&](int32_t serial) {
+        return atomOf[std::lower_bound(named.begin(), named.end(), serial) - named.begin()];
+    };
+
+    for (const ConectBond& bond : structure.conect) {
+        uint32_t a = find(bond.from);
+        uint32_t b = find(bond.to);
+        if (a == unresolved || b == unresolved || a == b)
+            continue;
+        if (structure.hetero[a] || structure.hetero[b])
+            pairs.push_back({std::min(a, b), std::max(a, b)});
+    }
+}
+
+void perceiveBonds(Structure& structure, ThreadPool& pool) {
+    std::vector<uint32_t>& offsets = structure.bondOffsets;
+    std::vector<uint32_t>& neighbors = structure.bondNeighbors;
+    offsets.clear();
+    neighbors.clear();
+    size_t n = structure.size();
+    if (n == 0)
+        return;
+
+    // The longest bond the present elements allow sets the cell size and search radius
+    // Half the tolerance goes on each radius, so a pair bonds when closer than their sum
+    std::vector<float> reach(n);
+    float maxRadius = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        reach[i] = elementInfo(structure.element[i]).covalentRadius + 0.5f * bondTolerance;
+        maxRadius = std::max(maxRadius, reach[i]);
+    }
+    float cutoff = 2.0f * maxRadius;
+    SpatialIndex index;
+    index.build(structure, cutoff, pool);
+
+    // One pair list per task, plus the CONECT bonds last
+    const float minSquared = minBondLength * minBondLength;
+    std::vector<std::vector<BondPair>> pairs(index.pairTaskCount() + 1);
+    index.forEachPair(cutoff, pool, [&](size_t task, uint32_t a, uint32_t b, float distanceSquared) {
+        float limit = reach[a] + reach[b];
+        if (distanceSquared < limit * limit && distanceSquared > minSquared && mayBond(structure, a, b))
+            pairs[task].push_back({a, b});
+    });
+    conectBonds(structure, pairs.back());
+
+    // Compressed sparse rows, each bond entered at both atoms
+    offsets.assign(n + 1, 0);
+    for (const std::vector<BondPair>& list : pairs) {
+        for (const BondPair& pair : list) {
+            ++offsets[pair.first + 1];
+            ++offsets[pair.second + 1];
+        }
+    }
+    for (size_t i = 0; i < n; ++i)
+        offsets[i + 1] += offsets[i];
+    neighbors.resize(offsets[n]);
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (const std::vector<BondPair>& list : pairs) {
+        for (const BondPair& pair : list) {
+            neighbors[cursor[pair.first]++] = pair.second;
+            neighbors[cursor[pair.second]++] = pair.first;
+        }
+    }
+
+    // Sort every row and drop CONECT bonds the distance test already found
+    const size_t atomBlockSize = 16384;
+    std::vector<uint32_t> rowLength(n);
+    pool.parallelFor((n + atomBlockSize - 1) / atomBlockSize, [&](size_t b) {
+        for (size_t i = b * atomBlockSize; i < std::min(n, (b + 1) * atomBlockSize); ++i) {
+            auto first = neighbors.begin() + offsets[i];
+            auto last = neighbors.begin() + offsets[i + 1];
+            std::sort(first, last);
+            rowLength[i] = static_cast<uint32_t>(std::unique(first, last) - first);
+        }
+    });
+    uint32_t write = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t read = offsets[i];
+        offsets[i] = write;
+        for (uint32_t k = 0; k < rowLength[i]; ++k)
+            neighbors[write++] = neighbors[read + k];
+    }
+    offsets[n] = write;
+    neighbors.resize(write);
+    neighbors.shrink_to_fit();
+}
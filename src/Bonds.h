@@ -0,0 +1,20 @@
+#ifndef BONDS_H
+#define BONDS_H
+
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Two atoms are bonded when closer than the sum of their covalent radii plus this slack
+constexpr float bondTolerance = 0.4f;
+// Pairs closer than this are overlapping alternate positions, not bonds
+constexpr float minBondLength = 0.4f;
+
+// Distance-based covalent bond perception in O(N). Atoms are binned into a SpatialIndex
+// whose cells are as wide as the longest bond the present elements allow, so every bond
+// partner of an atom lies in its own or one of the 26 neighboring cells. Atoms are tested
+// in parallel blocks on `pool`. Hydrogen pairs and atoms of different alternate locations
+// are never bonded. CONECT bonds with a HETATM end are merged in, which covers ligand
+// geometry the distance test gets wrong. Fills structure.bondOffsets/bondNeighbors.
+void perceiveBonds(Structure& structure, ThreadPool& pool);
+
+#endif
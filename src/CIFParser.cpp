@@ -0,0 +1,371 @@
+#include "CIFParser.h"
+#include "Elements.h"
+#include "PDBParser.h"
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+// ---- Tokenizer ----
+// Splits CIF text into whitespace-separated tokens, handling 'quoted', "quoted" and
+// ;-delimited multi-line values. Quotes are stripped from the returned token. Unless the
+// text is `final`, a token that runs into its end may continue beyond it and is held back.
+class CIFTokenizer
+{
+public:
+    CIFTokenizer(std::string_view text, bool final)
+        : origin(text.data()), cursor(text.data()), end(text.data() + text.size()), final(final) {}
+
+    // Bytes consumed so far
+    size_t position() const { return cursor - origin; }
+
+    // Returns false at the end of the text, or at a token cut off by it. `quoted` tells
+    // values apart from keywords.
+    bool next(std::string_view& token, bool& quoted) {
+        // Whitespace and comments; a ';' only opens a text field at the start of a line,
+        // which is checked lazily so the common path stays a single compare per byte
+        while (true) {
+            while (cursor < end && static_cast<unsigned char>(*cursor) <= ' ')
+                ++cursor;
+            if (cursor >= end)
+                return false;
+            if (*cursor != '#')
+                break;
+            const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+            if (newline == nullptr && !final)
+                return false;
+            cursor = newline != nullptr ? newline : end;
+        }
+
+        const char* tokenStart = cursor;
+        quoted = false;
+        char c = *cursor;
+        if (c == ';' && (cursor == origin || cursor[-1] == '\n')) {
+            // Text field: runs until a line that starts with ';'
+            const char* start = ++cursor;
+            while (cursor < end) {
+                const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+                if (newline == nullptr) {
+                    cursor = end;
+                    break;
+                }
+                cursor = newline + 1;
+                if (cursor < end && *cursor == ';') {
+                    token = std::string_view(start, newline - start);
+                    ++cursor;
+                    quoted = true;
+                    return true;
+                }
+            }
+            if (!final)
+                return held(tokenStart);
+            token = std::string_view(start, cursor - start);
+            quoted = true;
+            return true;
+        }
+        if (c == '\'' || c == '"') {
+            // A quote only closes when followed by whitespace
+            const char* start = ++cursor;
+            while (cursor < end) {
+                if (*cursor == c && (cursor + 1 == end || isSpace(cursor[1]))) {
+                    token = std::string_view(start, cursor - start);
+                    ++cursor;
+                    quoted = true;
+                    return true;
+                }
+                if (*cursor == '\n')
+                    break;
+                ++cursor;
+            }
+            if (cursor == end && !final)
+                return held(tokenStart);
+            token = std::string_view(start, cursor - start);
+            quoted = true;
+            return true;
+        }
+        // Bare token: anything above ' ' belongs to it
+        const char* start = cursor;
+        while (cursor < end && static_cast<unsigned char>(*cursor) > ' ')
+            ++cursor;
+        if (cursor == end && !final)
+            return held(start);
+        token = std::string_view(start, cursor - start);
+        return true;
+    }
+
+private:
+    bool held(const char* tokenStart) {
+        cursor = tokenStart;
+        return false;
+    }
+
+    static bool isSpace(char c) { return c <= ' ' && (c == ' ' || c == '\t' || c == '\n' || c == '\r'); }
+
+    const char* origin;
+    const char* cursor;
+    const char* end;
+    bool final;
+};
+
+// ---- Column mapping ----
+static const char* const atomSiteTags[CIFAtomReader::FieldCount] = {
+    "group_PDB", "id", "type_symbol", "label_atom_id", "auth_atom_id", "label_alt_id",
+    "label_comp_id", "auth_comp_id", "label_asym_id", "auth_asym_id", "label_seq_id",
+    "auth_seq_id", "pdbx_PDB_ins_code", "Cartn_x", "Cartn_y", "Cartn_z", "occupancy",
+    "B_iso_or_equiv", "pdbx_PDB_model_num"
+};
+
+static const char* const secondaryTags[CIFAtomReader::SecondaryFieldCount] = {
+    "conf_type_id", "beg_auth_asym_id", "beg_label_asym_id", "beg_auth_seq_id", "beg_label_seq_id",
+    "pdbx_beg_PDB_ins_code", "end_auth_asym_id", "end_label_asym_id", "end_auth_seq_id",
+    "end_label_seq_id", "pdbx_end_PDB_ins_code"
+};
+
+static bool isNull(std::string_view value, bool quoted) {
+    return !quoted && (value == "." || value == "?");
+}
+
+static char toUpper(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+static bool parseInt(std::string_view value, int32_t& out) {
+    if (!value.empty() && value[0] == '+')
+        value.remove_prefix(1);
+    auto result = std::from_chars(value.data(), value.data() + value.size(), out);
+    return result.ec == std::errc();
+}
+
+template <size_t N>
+static std::array<char, N> padded(std::string_view value) {
+    std::array<char, N> text;
+    text.fill(' ');
+    for (size_t i = 0; i < N && i < value.size(); ++i)
+        text[i] = value[i];
+    return text;
+}
+
+// PDB aligns atom names so that one-letter elements start in the second column
+// (" CA " is a carbon, "CA  " is calcium); mmCIF names are unpadded
+static AtomName alignAtomName(std::string_view name, size_t symbolLength) {
+    if (symbolLength == 1 && name.size() < 4) {
+        AtomName text;
+        text.fill(' ');
+        for (size_t i = 0; i < name.size(); ++i)
+            text[i + 1] = name[i];
+        return text;
+    }
+    return padded<4>(name);
+}
+
+// Reserved words and tags end a loop's value list; bare values can never start with '_'
+static bool isKeywordOrTag(std::string_view token) {
+    char c = token[0];
+    if (c == '_')
+        return true;
+    if (c != 'l' && c != 'd' && c != 's' && c != 'g' && c != 'L' && c != 'D' && c != 'S' && c != 'G')
+        return false;
+    return token == "loop_" || token.compare(0, 5, "data_") == 0 || token.compare(0, 5, "save_") == 0 ||
+           token == "stop_" || token == "global_";
+}
+
+// ---- Parser ----
+size_t CIFAtomReader::feed(std::string_view text, Structure& structure, bool final, size_t maxAtoms) {
+    CIFTokenizer tokenizer(text, final);
+    std::string_view token;
+    bool quoted = false;
+    // Start of the row being read: if the text ends inside it, it is read again next time
+    size_t rowStart = 0;
+
+    while (true) {
+        size_t before = tokenizer.position();
+        if (!tokenizer.next(token, quoted)) {
+            if (final)
+                return text.size();
+            size_t consumed = (state == State::Values && loop != Loop::Other && column > 0) ? rowStart : before;
+            column = 0;
+            return consumed;
+        }
+
+        if (state == State::Tags) {
+            // Tag list of this loop
+            if (!quoted && !token.empty() && token[0] == '_') {
+                const std::string_view atomSitePrefix = "_atom_site.";
+                const std::string_view helixPrefix = "_struct_conf.";
+                const std::string_view strandPrefix = "_struct_sheet_range.";
+                if (token.compare(0, atomSitePrefix.size(), atomSitePrefix) == 0) {
+                    loop = Loop::AtomSite;
+                    std::string_view tag = token.substr(atomSitePrefix.size());
+                    for (int f = 0; f < FieldCount; ++f) {
+                        if (tag == atomSiteTags[f])
+                            fieldColumn[f] = columns;
+                    }
+                } else if (token.compare(0, helixPrefix.size(), helixPrefix) == 0 ||
+                           token.compare(0, strandPrefix.size(), strandPrefix) == 0) {
+                    bool helix = token.compare(0, helixPrefix.size(), helixPrefix) == 0;
+                    loop = helix ? Loop::Helices : Loop::Strands;
+                    std::string_view tag = token.substr(helix ? helixPrefix.size() : strandPrefix.size());
+                    for (int f = 0; f < SecondaryFieldCount; ++f) {
+                        if (tag == secondaryTags[f])
+                            secondaryColumn[f] = columns;
+                    }
+                }
+                ++columns;
+                continue;
+            }
+            state = columns > 0 ? State::Values : State::Scanning;
+            column = 0;
+            row.assign(columns, {});
+        }
+
+        if (state == State::Values) {
+            // Values run until the next keyword or tag; only rows of the loops above are decoded
+            if (quoted || !isKeywordOrTag(token)) {
+                if (loop == Loop::Other)
+                    continue;
+                if (column == 0)
+                    rowStart = before;
+                row[column] = {token, quoted};
+                if (++column < columns)
+                    continue;
+                column = 0;
+                if (loop != Loop::AtomSite) {
+                    decodeSecondaryRow(structure);
+                    continue;
+                }
+                decodeRow(structure);
+                if (structure.size() >= maxAtoms)
+                    return tokenizer.position();
+                continue;
+            }
+            state = State::Scanning;
+        }
+
+        if (!quoted && token == "loop_") {
+            state = State::Tags;
+            fieldColumn.fill(-1);
+            secondaryColumn.fill(-1);
+            loop = Loop::Other;
+            columns = 0;
+            currentModel = INT32_MIN;
+        }
+    }
+}
+
+void CIFAtomReader::decodeRow(Structure& structure) {
+    auto field = [&](Field f) -> std::string_view {
+        int c = fieldColumn[f];
+        if (c < 0 || isNull(row[c].first, row[c].second))
+            return std::string_view();
+        return row[c].first;
+    };
+    auto preferred = [&](Field author, Field label) {
+        std::string_view value = field(author);
+        return value.empty() ? field(label) : value;
+    };
+
+    float x, y, z;
+    if (!parseFixedFloat(field(CartnX), x) || !parseFixedFloat(field(CartnY), y) ||
+        !parseFixedFloat(field(CartnZ), z))
+        return;
+
+    int32_t model = 0;
+    if (parseInt(field(ModelNum), model) && model != currentModel) {
+        structure.models.push_back({structure.size(), model, 0});
+        currentModel = model;
+    }
+
+    std::string_view symbol = field(TypeSymbol);
+    uint8_t element = elementFromSymbol(symbol.size() > 0 ? toUpper(symbol[0]) : ' ',
+                                        symbol.size() > 1 ? toUpper(symbol[1]) : ' ');
+    int32_t serial = 0;
+    if (!parseInt(field(Id), serial))
+        serial = structure.serial.empty() ? 1 : structure.serial.back() + 1;
+    int32_t residueNumber = 0;
+    parseInt(preferred(AuthSeqId, LabelSeqId), residueNumber);
+    float occupancy = 1.0f;
+    parseFixedFloat(field(Occupancy), occupancy);
+    float bFactor = 0.0f;
+    parseFixedFloat(field(BIso), bFactor);
+    std::string_view altLoc = field(LabelAltId);
+    std::string_view insertion = field(InsCode);
+
+    structure.x.push_back(x);
+    structure.y.push_back(y);
+    structure.z.push_back(z);
+    structure.element.push_back(element);
+    structure.serial.push_back(serial);
+    structure.atomName.push_back(alignAtomName(preferred(AuthAtomId, LabelAtomId), symbol.size()));
+    structure.altLoc.push_back(altLoc.empty() ? ' ' : altLoc[0]);
+    structure.residueName.push_back(padded<3>(preferred(AuthCompId, LabelCompId)));
+    structure.residueNumber.push_back(residueNumber);
+    structure.insertionCode.push_back(insertion.empty() ? ' ' : insertion[0]);
+    structure.chain.push_back(padded<4>(preferred(AuthAsymId, LabelAsymId)));
+    structure.occupancy.push_back(occupancy);
+    structure.bFactor.push_back(bFactor);
+    structure.hetero.push_back(field(GroupPDB) == "HETATM" ? 1 : 0);
+}
+
+void CIFAtomReader::decodeSecondaryRow(Structure& structure) {
+    auto field = [&](SecondaryField f) -> std::string_view {
+        int c = secondaryColumn[f];
+        if (c < 0 || isNull(row[c].first, row[c].second))
+            return std::string_view();
+        return row[c].first;
+    };
+    auto preferred = [&](SecondaryField author, SecondaryField label) {
+        std::string_view value = field(author);
+        return value.empty() ? field(label) : value;
+    };
+
+    // struct_conf also lists turns and bends; only the HELX_* types are helices
+    if (loop == Loop::Helices && field(ConfTypeId).compare(0, 4, "HELX") != 0)
+        return;
+    SecondaryRange range{};
+    if (!parseInt(preferred(BegAuthSeqId, BegLabelSeqId), range.firstResidue) ||
+        !parseInt(preferred(EndAuthSeqId, EndLabelSeqId), range.lastResidue))
+        return;
+    range.chain = padded<4>(preferred(BegAuthAsymId, BegLabelAsymId));
+    std::string_view firstInsertion = field(BegInsCode);
+    std::string_view lastInsertion = field(EndInsCode);
+    range.firstInsertion = firstInsertion.empty() ? ' ' : firstInsertion[0];
+    range.lastInsertion = lastInsertion.empty() ? ' ' : lastInsertion[0];
+    range.type = loop == Loop::Helices ? SecondaryHelix : SecondaryStrand;
+    structure.secondary.push_back(range);
+}
+
+size_t parseCIFAtoms(std::string_view text, Structure& structure,
+                     const std::function<bool(Structure&, size_t)>& flush, size_t flushEvery) {
+    CIFAtomReader reader;
+    size_t total = 0;
+    // Atom rows are rarely shorter than 80 bytes; bounded by the flush size when streaming
+    structure.reserve(structure.size() + (flush ? flushEvery : text.size() / 80 + 1));
+
+    size_t consumed = 0;
+    while (true) {
+        size_t before = structure.size();
+        consumed += reader.feed(text.substr(consumed), structure, true, flush ? flushEvery : SIZE_MAX);
+        total += structure.size() - before;
+        if (consumed >= text.size())
+            break;
+        if (!flush(structure, consumed))
+            return total;
+        structure.clear();
+    }
+
+    if (flush && (!structure.empty() || !structure.secondary.empty())) {
+        flush(structure, text.size());
+        structure.clear();
+    }
+    return total;
+}
+
+bool isCIFFile(const std::string& path, std::string_view text) {
+    auto endsWith = [&path](std::string_view suffix) {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith(".cif") || endsWith(".mmcif") || endsWith(".CIF"))
+        return true;
+    size_t start = text.find_first_not_of(" \t\r\n");
+    return start != std::string_view::npos && text.compare(start, 5, "data_") == 0;
+}
@@ -0,0 +1,74 @@
+#ifndef CIF_PARSER_H
+#define CIF_PARSER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Structure.h"
+
+// Reader for the _atom_site loop of mmCIF/PDBx files, for structures beyond the limits of
+// the PDB format (more than 99,999 atoms, multi-character chain IDs). Helices from the
+// _struct_conf loop and strands from _struct_sheet_range go to structure.secondary. The file is
+// tokenized in a single streaming pass; loop columns are mapped to Structure columns
+// once from the tag list, so rows are decoded by index without per-row lookups.
+//
+// If `flush` is given it is called every `flushEvery` atoms (and once at the end) with
+// the atoms parsed since the previous call and the number of bytes read so far; it takes
+// the atoms out of `structure`, which is then cleared. Returning false from `flush`
+// stops the parse. Returns the number of atoms parsed.
+size_t parseCIFAtoms(std::string_view text, Structure& structure,
+                     const std::function<bool(Structure&, size_t)>& flush = nullptr,
+                     size_t flushEvery = 1u << 17);
+
+// Incremental form of parseCIFAtoms for text that arrives in pieces (e.g. from a
+// decompressor). The reader keeps its place in the loop structure between calls, so a
+// file can be fed in any split without holding all of it in memory.
+class CIFAtomReader
+{
+public:
+    // _atom_site items the reader decodes
+    enum Field {
+        GroupPDB, Id, TypeSymbol, LabelAtomId, AuthAtomId, LabelAltId, LabelCompId, AuthCompId,
+        LabelAsymId, AuthAsymId, LabelSeqId, AuthSeqId, InsCode, CartnX, CartnY, CartnZ,
+        Occupancy, BIso, ModelNum, FieldCount
+    };
+    // _struct_conf and _struct_sheet_range items, which share their names
+    enum SecondaryField {
+        ConfTypeId, BegAuthAsymId, BegLabelAsymId, BegAuthSeqId, BegLabelSeqId, BegInsCode,
+        EndAuthAsymId, EndLabelAsymId, EndAuthSeqId, EndLabelSeqId, EndInsCode, SecondaryFieldCount
+    };
+
+    // Appends the atoms of every complete row in `text` to `structure` and returns the
+    // number of bytes consumed. The rest (a row or token cut off at the end of `text`)
+    // must be passed again at the front of the next call. With `final` set the text is
+    // taken to end the file and is consumed whole. Stops early, after a full row, once
+    // `structure` holds `maxAtoms` atoms.
+    size_t feed(std::string_view text, Structure& structure, bool final, size_t maxAtoms = SIZE_MAX);
+
+private:
+    enum class State { Scanning, Tags, Values };
+    // Loops whose rows are decoded
+    enum class Loop { Other, AtomSite, Helices, Strands };
+
+    void decodeRow(Structure& structure);
+    void decodeSecondaryRow(Structure& structure);
+
+    State state = State::Scanning;
+    std::array<int, FieldCount> fieldColumn{};
+    std::array<int, SecondaryFieldCount> secondaryColumn{};
+    Loop loop = Loop::Other;
+    int columns = 0;
+    int column = 0;
+    int32_t currentModel = INT32_MIN;
+    // Values of the row being read; they point into the text of the current feed() call
+    std::vector<std::pair<std::string_view, bool>> row;
+};
+
+// True for .cif/.mmcif paths, or text that starts with a CIF data block
+bool isCIFFile(const std::string& path, std::string_view text);
+
+#endif
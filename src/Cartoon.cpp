@@ -0,0 +1,329 @@
+#include "Cartoon.h"
+#include "AtomOrder.h"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace {
+
+// Consecutive CA atoms further apart than this are not bonded through a peptide
+const float maxAlphaGap = 4.2f;
+
+// Cross-section half width (along the carbonyl direction) and half thickness
+const glm::vec2 helixSection(1.3f, 0.25f);
+const glm::vec2 strandSection(1.1f, 0.25f);
+const glm::vec2 coilSection(0.3f, 0.3f);
+// Half width at the base of a strand's arrowhead; the head narrows to a coil tube
+const float arrowHalfWidth = 1.7f;
+
+const glm::vec3 helixColor(0.85f, 0.25f, 0.55f);
+const glm::vec3 strandColor(0.95f, 0.8f, 0.2f);
+const glm::vec3 coilColor(0.85f, 0.85f, 0.85f);
+
+const uint32_t noAtom = UINT32_MAX;
+
+// Any unit vector perpendicular to v
+glm::vec3 perpendicular(const glm::vec3& v) {
+    glm::vec3 axis = std::abs(v.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::normalize(glm::cross(v, axis));
+}
+
+glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+    float t2 = t * t, t3 = t2 * t;
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+glm::vec3 catmullRomTangent(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+    float t2 = t * t;
+    return 0.5f * ((p2 - p0) + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * (2.0f * t) +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * (3.0f * t2));
+}
+
+} // namespace
+
+bool Cartoon::ResidueKey::operator<(const ResidueKey& other) const {
+    return std::tie(chain, number, insertion) < std::tie(other.chain, other.number, other.insertion);
+}
+
+bool Cartoon::ResidueKey::operator==(const ResidueKey& other) const {
+    return chain == other.chain && number == other.number && insertion == other.insertion;
+}
+
+void Cartoon::clear() {
+    traces.clear();
+    residueChains.clear();
+    residueIndex.clear();
+    cartoonMesh.clear();
+    changed.clear();
+    atoms = 0;
+}
+
+void Cartoon::build(const Structure& structure, const std::vector<SecondaryRange>& secondary, ThreadPool& pool) {
+    clear();
+    atoms = structure.size();
+
+    // Residues in file order; those with a CA atom join the trace of their chain, or start
+    // a new one after a chain break
+    std::vector<uint32_t> order = fileOrderOf(structure);
+    auto residueOf = [&](size_t atom) -> ResidueKey {
+        return {structure.chain[atom], structure.residueNumber[atom], structure.insertionCode[atom]};
+    };
+    size_t k = 0;
+    while (k < order.size()) {
+        ResidueKey key = residueOf(order[k]);
+        uint32_t alpha = noAtom, oxygen = noAtom;
+        for (; k < order.size() && residueOf(order[k]) == key; ++k) {
+            uint32_t atom = order[k];
+            if (alpha == noAtom && structure.isAtomNamed(atom, " CA ") && structure.element[atom] == 6)
+                alpha = atom;
+            else if (oxygen == noAtom && structure.isAtomNamed(atom, " O  "))
+                oxygen = atom;
+        }
+        if (alpha == noAtom)
+            continue;
+        bool joins = !traces.empty() && structure.chain[traces.back().alpha.back()] == key.chain &&
+                     glm::length(structure.position(alpha) - structure.position(traces.back().alpha.back())) <= maxAlphaGap;
+        if (!joins) {
+            traces.emplace_back();
+            traces.back().firstResidue = static_cast<uint32_t>(residueChains.size());
+        }
+        Trace& trace = traces.back();
+        residueIndex.push_back({key, static_cast<uint32_t>(residueChains.size())});
+        residueChains.push_back(key.chain);
+        trace.alpha.push_back(alpha);
+        trace.oxygen.push_back(oxygen);
+    }
+    std::sort(residueIndex.begin(), residueIndex.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    // A lone CA has nothing to sweep along
+    traces.erase(std::remove_if(traces.begin(), traces.end(), [](const Trace& t) { return t.alpha.size() < 2; }),
+                 traces.end());
+
+    std::vector<uint8_t> types = residueTypes(secondary);
+    std::vector<SurfaceMesh> parts(traces.size());
+    pool.parallelFor(traces.size(), [&](size_t t) {
+        Trace& trace = traces[t];
+        trace.type.assign(types.begin() + trace.firstResidue, types.begin() + trace.firstResidue + trace.alpha.size());
+        captureBackbone(structure, traces[t]);
+        sweep(structure, traces[t], parts[t]);
+    });
+
+    // Lay the traces out one after another
+    std::vector<size_t> firstIndex(traces.size() + 1, 0);
+    uint32_t vertexCount = 0;
+    for (size_t t = 0; t < traces.size(); ++t) {
+        traces[t].vertices = {vertexCount, static_cast<uint32_t>(parts[t].vertexCount())};
+        vertexCount += traces[t].vertices.count;
+        firstIndex[t + 1] = firstIndex[t] + parts[t].indices.size();
+    }
+    cartoonMesh.positions.resize(vertexCount);
+    cartoonMesh.normals.resize(vertexCount);
+    cartoonMesh.colors.resize(vertexCount);
+    cartoonMesh.indices.resize(firstIndex.back());
+    pool.parallelFor(traces.size(), [&](size_t t) {
+        const SurfaceMesh& part = parts[t];
+        uint32_t first = traces[t].vertices.first;
+        std::copy(part.positions.begin(), part.positions.end(), cartoonMesh.positions.begin() + first);
+        std::copy(part.normals.begin(), part.normals.end(), cartoonMesh.normals.begin() + first);
+        std::copy(part.colors.begin(), part.colors.end(), cartoonMesh.colors.begin() + first);
+        for (size_t i = 0; i < part.indices.size(); ++i)
+            cartoonMesh.indices[firstIndex[t] + i] = first + part.indices[i];
+    });
+    changed.assign(1, {0, vertexCount});
+}
+
+size_t Cartoon::update(const Structure& structure, const std::vector<SecondaryRange>& secondary, ThreadPool& pool) {
+    changed.clear();
+    std::vector<uint8_t> types = residueTypes(secondary);
+    std::vector<uint8_t> moved(traces.size(), 0);
+    pool.parallelFor(traces.size(), [&](size_t t) {
+        Trace& trace = traces[t];
+        bool retyped = !std::equal(trace.type.begin(), trace.type.end(), types.begin() + trace.firstResidue);
+        if (retyped)
+            std::copy(types.begin() + trace.firstResidue, types.begin() + trace.firstResidue + trace.type.size(),
+                      trace.type.begin());
+        if (!captureBackbone(structure, trace) && !retyped)
+            return;
+        SurfaceMesh part;
+        sweep(structure, trace, part);
+        // Same residues, so the same vertex count and triangles
+        std::copy(part.positions.begin(), part.positions.end(), cartoonMesh.positions.begin() + trace.vertices.first);
+        std::copy(part.normals.begin(), part.normals.end(), cartoonMesh.normals.begin() + trace.vertices.first);
+        std::copy(part.colors.begin(), part.colors.end(), cartoonMesh.colors.begin() + trace.vertices.first);
+        moved[t] = 1;
+    });
+    for (size_t t = 0; t < traces.size(); ++t) {
+        if (!moved[t])
+            continue;
+        // Traces are laid out in order, so neighbors that both moved merge into one range
+        if (!changed.empty() && changed.back().first + changed.back().count == traces[t].vertices.first)
+            changed.back().count += traces[t].vertices.count;
+        else
+            changed.push_back(traces[t].vertices);
+    }
+    return std::count(moved.begin(), moved.end(), 1);
+}
+
+std::vector<uint8_t> Cartoon::residueTypes(const std::vector<SecondaryRange>& secondary) const {
+    // Every residue from the first to the last of a record, in file order, as long as it
+    // stays in the record's chain
+    std::vector<uint8_t> types(residueChains.size(), SecondaryCoil);
+    auto find = [&](const ResidueKey& key) -> int64_t {
+        auto it = std::lower_bound(residueIndex.begin(), residueIndex.end(), key,
+                                   [](const auto& entry, const ResidueKey& k) { return entry.first < k; });
+        return it != residueIndex.end() && it->first == key ? static_cast<int64_t>(it->second) : -1;
+    };
+    for (const SecondaryRange& range : secondary) {
+        int64_t first = find({range.chain, range.firstResidue, range.firstInsertion});
+        int64_t last = find({range.chain, range.lastResidue, range.lastInsertion});
+        if (first < 0 || last < first)
+            continue;
+        for (int64_t g = first; g <= last; ++g) {
+            if (residueChains[g] == range.chain)
+                types[g] = range.type;
+        }
+    }
+    return types;
+}
+
+bool Cartoon::captureBackbone(const Structure& structure, Trace& trace) {
+    bool moved = trace.backbone.size() != trace.alpha.size() * 2;
+    trace.backbone.resize(trace.alpha.size() * 2);
+    for (size_t r = 0; r < trace.alpha.size(); ++r) {
+        glm::vec3 alpha = structure.position(trace.alpha[r]);
+        glm::vec3 oxygen = trace.oxygen[r] != noAtom ? structure.position(trace.oxygen[r]) : alpha;
+        moved |= trace.backbone[2 * r] != alpha || trace.backbone[2 * r + 1] != oxygen;
+        trace.backbone[2 * r] = alpha;
+        trace.backbone[2 * r + 1] = oxygen;
+    }
+    return moved;
+}
+
+void Cartoon::sweep(const Structure& structure, const Trace& trace, SurfaceMesh& out) {
+    const size_t n = trace.alpha.size();
+    const int sides = crossSectionSides;
+    std::vector<glm::vec3> alpha(n);
+    for (size_t r = 0; r < n; ++r)
+        alpha[r] = structure.position(trace.alpha[r]);
+    auto point = [&](ptrdiff_t r) { return alpha[std::clamp<ptrdiff_t>(r, 0, n - 1)]; };
+
+    // Ribbon width direction at every residue: the carbonyl direction, made perpendicular to
+    // the trace and flipped to agree with the previous residue so the ribbon does not twist
+    std::vector<glm::vec3> side(n);
+    for (size_t r = 0; r < n; ++r) {
+        glm::vec3 tangent = glm::normalize(point(r + 1) - point(static_cast<ptrdiff_t>(r) - 1));
+        glm::vec3 carbonyl = trace.oxygen[r] != noAtom ? structure.position(trace.oxygen[r]) - alpha[r]
+                                                       : (r > 0 ? side[r - 1] : perpendicular(tangent));
+        glm::vec3 s = carbonyl - tangent * glm::dot(carbonyl, tangent);
+        s = glm::length(s) > 1e-4f ? glm::normalize(s) : (r > 0 ? side[r - 1] : perpendicular(tangent));
+        if (r > 0 && glm::dot(s, side[r - 1]) < 0.0f)
+            s = -s;
+        side[r] = s;
+    }
+
+    // Cross-section and color of every residue. The last residue of a strand is the tip of
+    // its arrow, which the segment before it narrows to.
+    std::vector<glm::vec2> section(n);
+    std::vector<glm::vec3> color(n);
+    std::vector<uint8_t> arrowSegment(n, 0);
+    for (size_t r = 0; r < n; ++r) {
+        uint8_t type = trace.type[r];
+        bool runStart = r == 0 || trace.type[r - 1] != type;
+        bool runEnd = r + 1 == n || trace.type[r + 1] != type;
+        // Single-residue helices and strands are drawn as coil
+        if (type != SecondaryCoil && runStart && runEnd)
+            type = SecondaryCoil;
+        section[r] = type == SecondaryHelix ? helixSection : type == SecondaryStrand ? strandSection : coilSection;
+        color[r] = type == SecondaryHelix ? helixColor : type == SecondaryStrand ? strandColor : coilColor;
+        if (type == SecondaryStrand && runEnd) {
+            section[r] = coilSection;
+            arrowSegment[r - 1] = 1;
+        }
+    }
+
+    float cosines[crossSectionSides], sines[crossSectionSides];
+    for (int k = 0; k < sides; ++k) {
+        cosines[k] = std::cos(6.2831853f * k / sides);
+        sines[k] = std::sin(6.2831853f * k / sides);
+    }
+    auto addRing = [&](const glm::vec3& center, const glm::vec3& tangent, const glm::vec3& guide,
+                       const glm::vec2& halfSize, const glm::vec3& ringColor) {
+        glm::vec3 normal = guide - tangent * glm::dot(guide, tangent);
+        normal = glm::length(normal) > 1e-4f ? glm::normalize(normal) : perpendicular(tangent);
+        glm::vec3 binormal = glm::cross(tangent, normal);
+        for (int k = 0; k < sides; ++k) {
+            float c = cosines[k], s = sines[k];
+            out.positions.push_back(center + normal * (halfSize.x * c) + binormal * (halfSize.y * s));
+            out.normals.push_back(glm::normalize(normal * (c / halfSize.x) + binormal * (s / halfSize.y)));
+            out.colors.push_back(ringColor);
+        }
+    };
+    auto addCap = [&](size_t ring, const glm::vec3& normal, bool end) {
+        uint32_t center = static_cast<uint32_t>(out.positions.size());
+        glm::vec3 middle(0.0f);
+        for (int k = 0; k < sides; ++k)
+            middle += out.positions[ring + k];
+        out.positions.push_back(middle / static_cast<float>(sides));
+        out.normals.push_back(normal);
+        out.colors.push_back(out.colors[ring]);
+        for (int k = 0; k < sides; ++k) {
+            out.positions.push_back(out.positions[ring + k]);
+            out.normals.push_back(normal);
+            out.colors.push_back(out.colors[ring + k]);
+        }
+        for (int k = 0; k < sides; ++k) {
+            uint32_t a = center + 1 + k, b = center + 1 + (k + 1) % sides;
+            out.indices.insert(out.indices.end(), {center, end ? a : b, end ? b : a});
+        }
+    };
+
+    size_t samples = (n - 1) * samplesPerResidue + 1;
+    out.positions.reserve(samples * sides + 2 * (sides + 1));
+    out.normals.reserve(out.positions.capacity());
+    out.colors.reserve(out.positions.capacity());
+    for (size_t r = 0; r + 1 < n || r == n - 1; ++r) {
+        int steps = r + 1 < n ? samplesPerResidue : 1;
+        for (int s = 0; s < steps; ++s) {
+            float t = static_cast<float>(s) / samplesPerResidue;
+            ptrdiff_t i = static_cast<ptrdiff_t>(r);
+            glm::vec3 p0 = point(i - 1), p1 = point(i), p2 = point(i + 1), p3 = point(i + 2);
+            glm::vec3 center = catmullRom(p0, p1, p2, p3, t);
+            glm::vec3 tangent = catmullRomTangent(p0, p1, p2, p3, t);
+            tangent = glm::length(tangent) > 1e-6f ? glm::normalize(tangent) : glm::normalize(p2 - p1);
+            size_t next = std::min(r + 1, n - 1);
+            glm::vec3 guide = glm::mix(side[r], side[next], t);
+            if (arrowSegment[r]) {
+                // The arrowhead: out to the full head width one sample in, then a straight
+                // taper. No extra rings, so the vertex count does not depend on the types.
+                glm::vec2 halfSize = section[r];
+                if (s > 0) {
+                    float u = (s - 1.0f) / (samplesPerResidue - 1.0f);
+                    halfSize = glm::mix(glm::vec2(arrowHalfWidth, strandSection.y), section[next], u);
+                }
+                addRing(center, tangent, guide, halfSize, strandColor);
+            } else {
+                float blend = t * t * (3.0f - 2.0f * t);
+                addRing(center, tangent, guide, glm::mix(section[r], section[next], blend), t < 0.5f ? color[r] : color[next]);
+            }
+        }
+        if (r == n - 1)
+            break;
+    }
+
+    // Quads between consecutive rings, wound counter-clockwise seen from outside
+    size_t rings = out.positions.size() / sides;
+    for (size_t ring = 0; ring + 1 < rings; ++ring) {
+        uint32_t base = static_cast<uint32_t>(ring * sides);
+        for (int k = 0; k < sides; ++k) {
+            uint32_t a = base + k, b = base + (k + 1) % sides;
+            uint32_t c = a + sides, d = b + sides;
+            out.indices.insert(out.indices.end(), {a, b, c, b, d, c});
+        }
+    }
+    glm::vec3 startTangent = glm::normalize(alpha[1] - alpha[0]);
+    glm::vec3 endTangent = glm::normalize(alpha[n - 1] - alpha[n - 2]);
+    addCap(0, -startTangent, false);
+    addCap((rings - 1) * sides, endTangent, true);
+}
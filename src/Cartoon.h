@@ -0,0 +1,87 @@
+#ifndef CARTOON_H
+#define CARTOON_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "IsoSurface.h"
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Cartoon of the protein backbone: a spline through the CA atoms of every chain, drawn as
+// flat ribbons along helices, arrows along strands and round tubes elsewhere. Residues get
+// their secondary structure from records such as structure.secondary (HELIX and SHEET) or
+// the output of assignSecondaryStructure() (SecondaryStructure.h).
+//
+// A chain is split into traces wherever consecutive CA atoms are too far apart to be
+// bonded. Every trace is swept on its own, in parallel, into its own range of the shared
+// mesh. Its vertex and index counts depend only on its number of residues, so when atoms
+// move or secondary structure changes, update() regenerates the affected traces in place
+// and leaves the rest, and their GPU copy, untouched.
+class Cartoon {
+public:
+    // Spline samples per residue, and vertices around the cross-section
+    static constexpr int samplesPerResidue = 6;
+    static constexpr int crossSectionSides = 8;
+
+    // A vertex range of the mesh
+    struct VertexRange {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // Finds the backbone traces of `structure` and sweeps all of them
+    void build(const Structure& structure, const std::vector<SecondaryRange>& secondary, ThreadPool& pool);
+    // Regenerates the traces whose CA or O atoms moved or whose secondary structure changed
+    // since the last build or update, and returns how many that was. changedRanges() lists
+    // the vertices rewritten.
+    size_t update(const Structure& structure, const std::vector<SecondaryRange>& secondary, ThreadPool& pool);
+    void clear();
+
+    const SurfaceMesh& mesh() const { return cartoonMesh; }
+    const std::vector<VertexRange>& changedRanges() const { return changed; }
+    size_t traceCount() const { return traces.size(); }
+    size_t residueCount() const { return residueChains.size(); }
+    // Number of atoms of the structure the cartoon was built for
+    size_t atomCount() const { return atoms; }
+
+private:
+    struct ResidueKey {
+        ChainId chain;
+        int32_t number;
+        char insertion;
+
+        bool operator<(const ResidueKey& other) const;
+        bool operator==(const ResidueKey& other) const;
+    };
+
+    struct Trace {
+        // Index of the first residue in residueChains; the rest follow
+        uint32_t firstResidue;
+        // Per residue: CA atom, carbonyl O atom (UINT32_MAX if missing) and SecondaryType
+        std::vector<uint32_t> alpha;
+        std::vector<uint32_t> oxygen;
+        std::vector<uint8_t> type;
+        // Backbone positions the geometry was last generated from, CA and O per residue
+        std::vector<glm::vec3> backbone;
+        VertexRange vertices;
+    };
+
+    // SecondaryType of every residue with a CA atom, in file order
+    std::vector<uint8_t> residueTypes(const std::vector<SecondaryRange>& secondary) const;
+    // Sweeps one trace into a local mesh
+    static void sweep(const Structure& structure, const Trace& trace, SurfaceMesh& out);
+    // Stores the trace's current backbone; returns true if it differs from the stored one
+    static bool captureBackbone(const Structure& structure, Trace& trace);
+
+    std::vector<Trace> traces;
+    // Every residue with a CA atom: its chain in file order, and its index by key
+    std::vector<ChainId> residueChains;
+    std::vector<std::pair<ResidueKey, uint32_t>> residueIndex;
+    SurfaceMesh cartoonMesh;
+    std::vector<VertexRange> changed;
+    size_t atoms = 0;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "ClusterBVH.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Clusters per refit/cull task
+static const size_t clusterBlockSize = 4096;
+// Depth at which the hierarchy is split into parallel cull tasks (up to 2^depth subtrees)
+static const int taskDepth = 6;
+
+ClusterBVH::Bounds ClusterBVH::emptyBounds() {
+    float inf = std::numeric_limits<float>::infinity();
+    return {glm::vec3(inf), glm::vec3(-inf)};
+}
+
+void ClusterBVH::clear() {
+    clusters.clear();
+    clusterBounds.clear();
+    clusterOrder.clear();
+    nodes.clear();
+    clusterVisible.clear();
+    atoms = 0;
+    lastVisibleClusters = 0;
+    lastVisibleAtoms = 0;
+}
+
+void ClusterBVH::build(const Structure& structure, const std::vector<SphereInstance>& instances, ThreadPool& pool) {
+    clear();
+    atoms = std::min(structure.size(), instances.size());
+
+    // A new cluster starts wherever chain, residue number or insertion code changes
+    for (size_t i = 0; i < atoms; ++i) {
+        bool sameResidue = i > 0 && clusters.back().count < maxClusterAtoms && structure.sameResidue(i, i - 1);
+        if (sameResidue)
+            ++clusters.back().count;
+        else
+            clusters.push_back({static_cast<uint32_t>(i), 1});
+    }
+    if (clusters.empty())
+        return;
+
+    clusterBounds.resize(clusters.size());
+    clusterVisible.assign(clusters.size(), 0);
+    clusterOrder.resize(clusters.size());
+    for (size_t c = 0; c < clusters.size(); ++c)
+        clusterOrder[c] = static_cast<uint32_t>(c);
+
+    // Topology first (split on cluster centers), bounds afterwards through refit
+    refit(instances, pool);
+    std::vector<glm::vec3> centers(clusters.size());
+    for (size_t c = 0; c < clusters.size(); ++c)
+        centers[c] = (clusterBounds[c].min + clusterBounds[c].max) * 0.5f;
+    nodes.reserve(2 * clusters.size() / leafClusters + 1);
+    buildNode(0, static_cast<uint32_t>(clusters.size()), centers);
+    refitNodes();
+}
+
+// Median split along the widest axis of the cluster centers
+uint32_t ClusterBVH::buildNode(uint32_t begin, uint32_t end, std::vector<glm::vec3>& centers) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({emptyBounds(), begin, end, 0});
+    if (end - begin <= leafClusters)
+        return index;
+
+    Bounds centerBounds = emptyBounds();
+    for (uint32_t i = begin; i < end; ++i) {
+        centerBounds.min = glm::min(centerBounds.min, centers[clusterOrder[i]]);
+        centerBounds.max = glm::max(centerBounds.max, centers[clusterOrder[i]]);
+    }
+    glm::vec3 extent = centerBounds.max - centerBounds.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(clusterOrder.begin() + begin, clusterOrder.begin() + middle, clusterOrder.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+    buildNode(begin, middle, centers);
+    uint32_t right = buildNode(middle, end, centers);
+    nodes[index].right = right;
+    return index;
+}
+
+void ClusterBVH::refit(const std::vector<SphereInstance>& instances, ThreadPool& pool) {
+    if (clusters.empty() || instances.size() < atoms)
+        return;
+    size_t blocks = (clusters.size() + clusterBlockSize - 1) / clusterBlockSize;
+    pool.parallelFor(blocks, [&](size_t b) {
+        size_t end = std::min(clusters.size(), (b + 1) * clusterBlockSize);
+        for (size_t c = b * clusterBlockSize; c < end; ++c) {
+            Bounds bounds = emptyBounds();
+            for (uint32_t i = clusters[c].first; i < clusters[c].first + clusters[c].count; ++i) {
+                glm::vec3 r(instances[i].radius);
+                bounds.min = glm::min(bounds.min, instances[i].position - r);
+                bounds.max = glm::max(bounds.max, instances[i].position + r);
+            }
+            clusterBounds[c] = bounds;
+        }
+    });
+    if (!nodes.empty())
+        refitNodes();
+}
+
+// Children always follow their parent, so a reverse sweep sees them first
+void ClusterBVH::refitNodes() {
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        Bounds bounds = emptyBounds();
+        if (node.right == 0) {
+            for (uint32_t i = node.begin; i < node.end; ++i) {
+                bounds.min = glm::min(bounds.min, clusterBounds[clusterOrder[i]].min);
+                bounds.max = glm::max(bounds.max, clusterBounds[clusterOrder[i]].max);
+            }
+        } else {
+            const Bounds& left = nodes[n + 1].bounds;
+            const Bounds& right = nodes[node.right].bounds;
+            bounds = {glm::min(left.min, right.min), glm::max(left.max, right.max)};
+        }
+        node.bounds = bounds;
+    }
+}
+
+int ClusterBVH::classify(const Bounds& bounds, const Planes& planes) {
+    bool inside = true;
+    for (const glm::vec4& plane : planes) {
+        glm::vec3 normal(plane);
+        // Corner furthest along the plane normal, and the one furthest against it
+        glm::vec3 positive(normal.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                           normal.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                           normal.z >= 0.0f ? bounds.max.z : bounds.min.z);
+        if (glm::dot(normal, positive) + plane.w < 0.0f)
+            return -1;
+        glm::vec3 negative(normal.x >= 0.0f ? bounds.min.x : bounds.max.x,
+                           normal.y >= 0.0f ? bounds.min.y : bounds.max.y,
+                           normal.z >= 0.0f ? bounds.min.z : bounds.max.z);
+        if (glm::dot(normal, negative) + plane.w < 0.0f)
+            inside = false;
+    }
+    return inside ? 1 : 0;
+}
+
+void ClusterBVH::markRange(const Node& node) {
+    for (uint32_t i = node.begin; i < node.end; ++i)
+        clusterVisible[clusterOrder[i]] = 1;
+}
+
+void ClusterBVH::cullSubtree(uint32_t root, const Planes& planes) {
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        int side = classify(node.bounds, planes);
+        if (side < 0)
+            continue;
+        if (side > 0) {
+            markRange(node);
+            continue;
+        }
+        if (node.right == 0) {
+            for (uint32_t i = node.begin; i < node.end; ++i) {
+                uint32_t c = clusterOrder[i];
+                clusterVisible[c] = classify(clusterBounds[c], planes) >= 0;
+            }
+            continue;
+        }
+        stack[top++] = node.right;
+        stack[top++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+    }
+}
+
+void ClusterBVH::cull(const glm::mat4& viewProjection, std::vector<InstanceRange>& visible, ThreadPool& pool) {
+    visible.clear();
+    lastVisibleClusters = 0;
+    lastVisibleAtoms = 0;
+    if (nodes.empty())
+        return;
+
+    // Frustum planes from the rows of the combined matrix (Gribb & Hartmann)
+    glm::mat4 m = glm::transpose(viewProjection);
+    Planes planes = {m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]};
+    std::fill(clusterVisible.begin(), clusterVisible.end(), 0);
+
+    // Walk the top of the tree serially to collect subtrees, then cull those in parallel
+    std::vector<uint32_t> tasks;
+    std::vector<std::pair<uint32_t, int>> frontier = {{0, 0}};
+    while (!frontier.empty()) {
+        auto [index, depth] = frontier.back();
+        frontier.pop_back();
+        const Node& node = nodes[index];
+        if (depth == taskDepth || node.right == 0) {
+            tasks.push_back(index);
+            continue;
+        }
+        int side = classify(node.bounds, planes);
+        if (side < 0)
+            continue;
+        if (side > 0) {
+            markRange(node);
+            continue;
+        }
+        frontier.push_back({node.right, depth + 1});
+        frontier.push_back({index + 1, depth + 1});
+    }
+    pool.parallelFor(tasks.size(), [&](size_t t) { cullSubtree(tasks[t], planes); });
+
+    lastVisibleClusters = std::count(clusterVisible.begin(), clusterVisible.end(), 1);
+    rangesOf(clusterVisible, visible);
+    for (const InstanceRange& range : visible)
+        lastVisibleAtoms += range.count;
+}
+
+// Flagged clusters in instance order, merged into ranges across small gaps
+void ClusterBVH::rangesOf(const std::vector<uint8_t>& flags, std::vector<InstanceRange>& ranges) const {
+    ranges.clear();
+    for (size_t c = 0; c < clusters.size() && c < flags.size(); ++c) {
+        if (!flags[c])
+            continue;
+        const Cluster& cluster = clusters[c];
+        if (!ranges.empty() && cluster.first - (ranges.back().first + ranges.back().count) < mergeGap)
+            ranges.back().count = cluster.first + cluster.count - ranges.back().first;
+        else
+            ranges.push_back({cluster.first, cluster.count});
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef CLUSTER_BVH_H
+#define CLUSTER_BVH_H
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Structure.h"
+#include "Sphere.h"
+#include "InstanceBuffer.h"
+#include "ThreadPool.h"
+
+// Bounding volume hierarchy over clusters of atoms, used to cull the structure against
+// the view frustum. A cluster is a run of consecutive atoms of one residue (at most
+// maxClusterAtoms), so every cluster is also a contiguous range of instances and the
+// visible set can be drawn as a few merged ranges.
+class ClusterBVH
+{
+public:
+    static constexpr uint32_t maxClusterAtoms = 256;
+    static constexpr uint32_t leafClusters = 4;
+    // Visible ranges separated by fewer culled atoms than this are drawn as one
+    static constexpr uint32_t mergeGap = 32;
+
+    void clear();
+    // Groups atoms into clusters and builds the hierarchy over their bounding boxes
+    void build(const Structure& structure, const std::vector<SphereInstance>& instances, ThreadPool& pool);
+    // Recomputes every bound after the atoms moved (e.g. a new trajectory frame)
+    void refit(const std::vector<SphereInstance>& instances, ThreadPool& pool);
+
+    // Tests the hierarchy against the frustum of `viewProjection` and writes the instance
+    // ranges to draw, in instance order
+    void cull(const glm::mat4& viewProjection, std::vector<InstanceRange>& visible, ThreadPool& pool);
+
+    // Instance ranges of the clusters whose flag is set, merged like cull() does
+    void rangesOf(const std::vector<uint8_t>& flags, std::vector<InstanceRange>& ranges) const;
+
+    struct Bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+    const Bounds& bounds(size_t cluster) const { return clusterBounds[cluster]; }
+    // Per-cluster result of the last cull(): 1 if inside the frustum
+    const std::vector<uint8_t>& frustumVisible() const { return clusterVisible; }
+
+    bool empty() const { return clusters.empty(); }
+    size_t atomCount() const { return atoms; }
+    size_t clusterCount() const { return clusters.size(); }
+    // Results of the last cull()
+    size_t visibleClusters() const { return lastVisibleClusters; }
+    // Atoms in the visible ranges, including the small culled gaps merged into them
+    size_t visibleAtoms() const { return lastVisibleAtoms; }
+
+private:
+    struct Cluster {
+        uint32_t first;
+        uint32_t count;
+    };
+    // Nodes are stored depth first: an inner node's left child follows it directly.
+    // Every node covers clusterOrder[begin, end).
+    struct Node {
+        Bounds bounds;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t right; // 0 for leaves
+    };
+    using Planes = std::array<glm::vec4, 6>;
+
+    uint32_t buildNode(uint32_t begin, uint32_t end, std::vector<glm::vec3>& centers);
+    void refitNodes();
+    void markRange(const Node& node);
+    void cullSubtree(uint32_t root, const Planes& planes);
+    static Bounds emptyBounds();
+    // -1 outside, 0 intersecting, 1 inside
+    static int classify(const Bounds& bounds, const Planes& planes);
+
+    std::vector<Cluster> clusters;
+    std::vector<Bounds> clusterBounds;
+    std::vector<uint32_t> clusterOrder;
+    std::vector<Node> nodes;
+    std::vector<uint8_t> clusterVisible;
+    size_t atoms = 0;
+
+    size_t lastVisibleClusters = 0;
+    size_t lastVisibleAtoms = 0;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef ELEMENTS_H
+#define ELEMENTS_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Compile-time periodic table indexed by atomic number. Index 0 is the "unknown element"
+// entry that any unrecognised symbol resolves to.
+struct ElementInfo {
+    char symbol[3];         // upper case, as written in PDB columns 77-78
+    float vdwRadius;        // van der Waals radius in Angstroms
+    float covalentRadius;   // single-bond covalent radius in Angstroms
+    float r, g, b;          // CPK color
+};
+
+namespace ElementColor {
+    // cpk coloring, see README
+    constexpr float White[3]      = {1.0f, 1.0f, 1.0f};
+    constexpr float Gray[3]       = {0.784f, 0.784f, 0.784f};
+    constexpr float Red[3]        = {0.941f, 0.0f, 0.0f};
+    constexpr float LightBlue[3]  = {0.561f, 0.561f, 1.0f};
+    constexpr float Yellow[3]     = {1.0f, 0.784f, 0.0f};
+    constexpr float Orange[3]     = {1.0f, 0.647f, 0.0f};
+    constexpr float Blue[3]       = {0.0f, 0.0f, 1.0f};
+    constexpr float Green[3]      = {0.0f, 1.0f, 0.0f};
+    constexpr float DarkGrey[3]   = {0.502f, 0.502f, 0.565f};
+    constexpr float Brown[3]      = {0.647f, 0.165f, 0.165f};
+    constexpr float ForestGreen[3]= {0.133f, 0.545f, 0.133f};
+    constexpr float Cyan[3]       = {0.0f, 1.0f, 1.0f};
+    constexpr float Violet[3]     = {0.5f, 0.0f, 1.0f};
+    constexpr float DarkGreen[3]  = {0.0f, 0.5f, 0.0f};
+    constexpr float DarkViolet[3] = {0.58f, 0.0f, 0.827f};
+    constexpr float Beige[3]      = {0.961f, 0.961f, 0.863f};
+    constexpr float Pink[3]       = {1.0f, 0.753f, 0.796f};
+}
+
+constexpr ElementInfo makeElement(const char (&symbol)[3], float vdwRadius, float covalentRadius, const float (&color)[3]) {
+    return ElementInfo{{symbol[0], symbol[1], '\0'}, vdwRadius, covalentRadius, color[0], color[1], color[2]};
+}
+
+// van der Waals radii after Bondi (1964) and Mantina et al. (2009); 2.0 where neither
+// tabulates a value. Covalent radii after Cordero et al. (2008), low-spin values for the
+// transition metals; 1.5 beyond curium, 0.75 (about carbon) for unknown elements.
+constexpr std::array<ElementInfo, 119> elementTable = {{
+    makeElement("? ", 1.50f, 0.75f, ElementColor::White),
+    makeElement("H ", 1.20f, 0.31f, ElementColor::White),
+    makeElement("HE", 1.40f, 0.28f, ElementColor::Cyan),
+    makeElement("LI", 1.82f, 1.28f, ElementColor::Violet),
+    makeElement("BE", 1.53f, 0.96f, ElementColor::DarkGreen),
+    makeElement("B ", 1.92f, 0.84f, ElementColor::Beige),
+    makeElement("C ", 1.70f, 0.76f, ElementColor::Gray),
+    makeElement("N ", 1.55f, 0.71f, ElementColor::LightBlue),
+    makeElement("O ", 1.52f, 0.66f, ElementColor::Red),
+    makeElement("F ", 1.47f, 0.57f, ElementColor::Green),
+    makeElement("NE", 1.54f, 0.58f, ElementColor::Cyan),
+    makeElement("NA", 2.27f, 1.66f, ElementColor::Blue),
+    makeElement("MG", 1.73f, 1.41f, ElementColor::ForestGreen),
+    makeElement("AL", 1.84f, 1.21f, ElementColor::DarkGrey),
+    makeElement("SI", 2.10f, 1.11f, ElementColor::Beige),
+    makeElement("P ", 1.80f, 1.07f, ElementColor::Orange),
+    makeElement("S ", 1.80f, 1.05f, ElementColor::Yellow),
+    makeElement("CL", 1.75f, 1.02f, ElementColor::Green),
+    makeElement("AR", 1.88f, 1.06f, ElementColor::Cyan),
+    makeElement("K ", 2.75f, 2.03f, ElementColor::Violet),
+    makeElement("CA", 1.97f, 1.76f, ElementColor::DarkGrey),
+    makeElement("SC", 2.00f, 1.70f, ElementColor::Pink),
+    makeElement("TI", 2.00f, 1.60f, ElementColor::DarkGrey),
+    makeElement("V ", 2.00f, 1.53f, ElementColor::Pink),
+    makeElement("CR", 2.00f, 1.39f, ElementColor::DarkGrey),
+    makeElement("MN", 2.00f, 1.39f, ElementColor::DarkGrey),
+    makeElement("FE", 1.94f, 1.32f, ElementColor::Orange),
+    makeElement("CO", 2.00f, 1.26f, ElementColor::Pink),
+    makeElement("NI", 1.63f, 1.24f, ElementColor::Brown),
+    makeElement("CU", 1.40f, 1.32f, ElementColor::Brown),
+    makeElement("ZN", 1.39f, 1.22f, ElementColor::Brown),
+    makeElement("GA", 1.87f, 1.22f, ElementColor::Pink),
+    makeElement("GE", 2.11f, 1.20f, ElementColor::Pink),
+    makeElement("AS", 1.85f, 1.19f, ElementColor::Pink),
+    makeElement("SE", 1.90f, 1.20f, ElementColor::Pink),
+    makeElement("BR", 1.85f, 1.20f, ElementColor::Brown),
+    makeElement("KR", 2.02f, 1.16f, ElementColor::Cyan),
+    makeElement("RB", 3.03f, 2.20f, ElementColor::Violet),
+    makeElement("SR", 2.49f, 1.95f, ElementColor::DarkGreen),
+    makeElement("Y ", 2.00f, 1.90f, ElementColor::Pink),
+    makeElement("ZR", 2.00f, 1.75f, ElementColor::Pink),
+    makeElement("NB", 2.00f, 1.64f, ElementColor::Pink),
+    makeElement("MO", 2.00f, 1.54f, ElementColor::Pink),
+    makeElement("TC", 2.00f, 1.47f, ElementColor::Pink),
+    makeElement("RU", 2.00f, 1.46f, ElementColor::Pink),
+    makeElement("RH", 2.00f, 1.42f, ElementColor::Pink),
+    makeElement("PD", 1.63f, 1.39f, ElementColor::Pink),
+    makeElement("AG", 1.72f, 1.45f, ElementColor::DarkGrey),
+    makeElement("CD", 1.58f, 1.44f, ElementColor::Pink),
+    makeElement("IN", 1.93f, 1.42f, ElementColor::Pink),
+    makeElement("SN", 2.17f, 1.39f, ElementColor::Pink),
+    makeElement("SB", 2.06f, 1.39f, ElementColor::Pink),
+    makeElement("TE", 2.06f, 1.38f, ElementColor::Pink),
+    makeElement("I ", 1.98f, 1.39f, ElementColor::DarkViolet),
+    makeElement("XE", 2.16f, 1.40f, ElementColor::Cyan),
+    makeElement("CS", 3.43f, 2.44f, ElementColor::Violet),
+    makeElement("BA", 2.68f, 2.15f, ElementColor::DarkGreen),
+    makeElement("LA", 2.00f, 2.07f, ElementColor::Pink),
+    makeElement("CE", 2.00f, 2.04f, ElementColor::Pink),
+    makeElement("PR", 2.00f, 2.03f, ElementColor::Pink),
+    makeElement("ND", 2.00f, 2.01f, ElementColor::Pink),
+    makeElement("PM", 2.00f, 1.99f, ElementColor::Pink),
+    makeElement("SM", 2.00f, 1.98f, ElementColor::Pink),
+    makeElement("EU", 2.00f, 1.98f, ElementColor::Pink),
+    makeElement("GD", 2.00f, 1.96f, ElementColor::Pink),
+    makeElement("TB", 2.00f, 1.94f, ElementColor::Pink),
+    makeElement("DY", 2.00f, 1.92f, ElementColor::Pink),
+    makeElement("HO", 2.00f, 1.92f, ElementColor::Pink),
+    makeElement("ER", 2.00f, 1.89f, ElementColor::Pink),
+    makeElement("TM", 2.00f, 1.90f, ElementColor::Pink),
+    makeElement("YB", 2.00f, 1.87f, ElementColor::Pink),
+    makeElement("LU", 2.00f, 1.87f, ElementColor::Pink),
+    makeElement("HF", 2.00f, 1.75f, ElementColor::Pink),
+    makeElement("TA", 2.00f, 1.70f, ElementColor::Pink),
+    makeElement("W ", 2.00f, 1.62f, ElementColor::Pink),
+    makeElement("RE", 2.00f, 1.51f, ElementColor::Pink),
+    makeElement("OS", 2.00f, 1.44f, ElementColor::Pink),
+    makeElement("IR", 2.00f, 1.41f, ElementColor::Pink),
+    makeElement("PT", 1.75f, 1.36f, ElementColor::Pink),
+    makeElement("AU", 1.66f, 1.36f, ElementColor::Pink),
+    makeElement("HG", 1.55f, 1.32f, ElementColor::Pink),
+    makeElement("TL", 1.96f, 1.45f, ElementColor::Pink),
+    makeElement("PB", 2.02f, 1.46f, ElementColor::Pink),
+    makeElement("BI", 2.07f, 1.48f, ElementColor::Pink),
+    makeElement("PO", 1.97f, 1.40f, ElementColor::Pink),
+    makeElement("AT", 2.02f, 1.50f, ElementColor::Pink),
+    makeElement("RN", 2.20f, 1.50f, ElementColor::Cyan),
+    makeElement("FR", 3.48f, 2.60f, ElementColor::Violet),
+    makeElement("RA", 2.83f, 2.21f, ElementColor::DarkGreen),
+    makeElement("AC", 2.00f, 2.15f, ElementColor::Pink),
+    makeElement("TH", 2.00f, 2.06f, ElementColor::Pink),
+    makeElement("PA", 2.00f, 2.00f, ElementColor::Pink),
+    makeElement("U ", 1.86f, 1.96f, ElementColor::Pink),
+    makeElement("NP", 2.00f, 1.90f, ElementColor::Pink),
+    makeElement("PU", 2.00f, 1.87f, ElementColor::Pink),
+    makeElement("AM", 2.00f, 1.80f, ElementColor::Pink),
+    makeElement("CM", 2.00f, 1.69f, ElementColor::Pink),
+    makeElement("BK", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("CF", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("ES", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("FM", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("MD", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("NO", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("LR", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("RF", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("DB", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("SG", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("BH", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("HS", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("MT", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("DS", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("RG", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("CN", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("NH", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("FL", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("MC", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("LV", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("TS", 2.00f, 1.50f, ElementColor::Pink),
+    makeElement("OG", 2.00f, 1.50f, ElementColor::Pink),
+}};
+
+// Perfect hash of a PDB element column: first letter A-Z, second letter ' ' or A-Z.
+// Every valid symbol maps to a distinct slot, so lookup is a single table read.
+constexpr size_t elementHashSize = 26 * 27;
+
+constexpr int elementHash(char first, char second) {
+    if (first < 'A' || first > 'Z')
+        return -1;
+    int low;
+    if (second == ' ' || second == '\0')
+        low = 0;
+    else if (second >= 'A' && second <= 'Z')
+        low = second - 'A' + 1;
+    else
+        return -1;
+    return (first - 'A') * 27 + low;
+}
+
+constexpr std::array<uint8_t, elementHashSize> buildElementHash() {
+    std::array<uint8_t, elementHashSize> slots{};
+    for (size_t z = 1; z < elementTable.size(); ++z) {
+        int slot = elementHash(elementTable[z].symbol[0], elementTable[z].symbol[1]);
+        slots[slot] = static_cast<uint8_t>(z);
+    }
+    return slots;
+}
+
+constexpr std::array<uint8_t, elementHashSize> elementHashTable = buildElementHash();
+
+// Atomic number for an upper-case symbol ("C", ' ' or "FE"); 0 when unknown
+constexpr uint8_t elementFromSymbol(char first, char second) {
+    int slot = elementHash(first, second);
+    return slot < 0 ? 0 : elementHashTable[slot];
+}
+
+constexpr const ElementInfo& elementInfo(uint8_t atomicNumber) {
+    return elementTable[atomicNumber < elementTable.size() ? atomicNumber : 0];
+}
+
+inline glm::vec3 elementColor(uint8_t atomicNumber) {
+    const ElementInfo& info = elementInfo(atomicNumber);
+    return glm::vec3(info.r, info.g, info.b);
+}
+
+static_assert(elementFromSymbol('C', ' ') == 6, "element hash must resolve carbon");
+static_assert(elementFromSymbol('F', 'E') == 26, "element hash must resolve iron");
+static_assert(elementFromSymbol('O', 'G') == 118, "element table must reach oganesson");
+
+#endif
@@ -0,0 +1,131 @@
+#include "GzipStream.h"
+#include <algorithm>
+#include <zlib.h>
+
+GzipStream::~GzipStream() {
+    stop();
+}
+
+void GzipStream::start(std::string_view compressed) {
+    stop();
+    storage.assign(blockSize * blockCount, 0);
+    produced = 0;
+    consumed = 0;
+    finished = false;
+    stopping = false;
+    holding = false;
+    error = false;
+    inputRead = 0;
+    worker = std::thread(&GzipStream::run, this, compressed);
+}
+
+void GzipStream::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool GzipStream::next(std::string_view& data) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (holding) {
+        // Hand the previous block back to the inflate thread
+        ++consumed;
+        holding = false;
+        changed.notify_all();
+    }
+    changed.wait(lock, [this] { return produced > consumed || finished; });
+    if (produced == consumed)
+        return false;
+    size_t slot = consumed % blockCount;
+    data = std::string_view(storage.data() + slot * blockSize, lengths[slot]);
+    holding = true;
+    return true;
+}
+
+void GzipStream::run(std::string_view compressed) {
+    z_stream zs{};
+    // 15 window bits + 32: accept gzip or zlib headers
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+        error = true;
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        changed.notify_all();
+        return;
+    }
+
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(compressed.data());
+    size_t inputLeft = compressed.size();
+    bool streamEnd = false;
+    while (!streamEnd) {
+        // Wait for a free block in the ring
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return produced - consumed < blockCount || stopping; });
+            if (stopping)
+                break;
+            slot = produced % blockCount;
+        }
+
+        char* block = storage.data() + slot * blockSize;
+        zs.next_out = reinterpret_cast<Bytef*>(block);
+        zs.avail_out = static_cast<uInt>(blockSize);
+        while (zs.avail_out > 0) {
+            if (zs.avail_in == 0) {
+                if (inputLeft == 0) {
+                    // Truncated file
+                    error = true;
+                    streamEnd = true;
+                    break;
+                }
+                // avail_in is 32-bit; hand the mapping over in slices
+                size_t piece = std::min<size_t>(inputLeft, 1u << 30);
+                zs.next_in = const_cast<Bytef*>(input);
+                zs.avail_in = static_cast<uInt>(piece);
+                input += piece;
+                inputLeft -= piece;
+            }
+            int status = inflate(&zs, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                // Archives such as BGZF are several gzip members back to back. Anything else
+                // after a complete member, such as zero padding, is ignored as gzip -d does.
+                std::string_view rest(reinterpret_cast<const char*>(zs.next_in), zs.avail_in + inputLeft);
+                if (!isGzipData(rest)) {
+                    streamEnd = true;
+                    break;
+                }
+                inflateReset(&zs);
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                error = true;
+                streamEnd = true;
+                break;
+            }
+        }
+        inputRead = compressed.size() - inputLeft - zs.avail_in;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        lengths[slot] = blockSize - zs.avail_out;
+        ++produced;
+        changed.notify_all();
+    }
+
+    inflateEnd(&zs);
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    changed.notify_all();
+}
+
+bool isGzipData(std::string_view data) {
+    return data.size() >= 2 && static_cast<unsigned char>(data[0]) == 0x1f &&
+           static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+std::string stripGzipExtension(const std::string& path) {
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0)
+        return path.substr(0, path.size() - 3);
+    return path;
+}
@@ -0,0 +1,70 @@
+#ifndef GZIP_STREAM_H
+#define GZIP_STREAM_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Inflates gzip data on its own thread into a small ring of fixed-size blocks, which the
+// consumer takes one at a time. Decompression runs ahead of the parser by at most the
+// ring's capacity, so the two overlap while the uncompressed file is never held whole.
+class GzipStream
+{
+public:
+    static constexpr size_t blockSize = 1u << 20;
+    static constexpr size_t blockCount = 8;
+
+    GzipStream() = default;
+    ~GzipStream();
+
+    GzipStream(const GzipStream&) = delete;
+    GzipStream& operator=(const GzipStream&) = delete;
+
+    // Starts inflating `compressed`, which must stay valid until the stream is stopped
+    void start(std::string_view compressed);
+    // Stops the inflate thread early (e.g. when the load is cancelled)
+    void stop();
+
+    // Consumer side: waits for the next block of decompressed bytes. The view stays valid
+    // until the next call. Returns false at the end of the data or on a decoding error.
+    bool next(std::string_view& data);
+
+    bool failed() const { return error.load(); }
+    // Compressed bytes inflated so far, for progress reporting
+    size_t bytesRead() const { return inputRead.load(); }
+
+private:
+    void run(std::string_view compressed);
+
+    std::thread worker;
+    std::vector<char> storage;
+    std::array<size_t, blockCount> lengths{};
+
+    // Blocks are filled and taken in order; `produced - consumed` is the number in flight
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t produced = 0;
+    size_t consumed = 0;
+    bool finished = false;
+    bool stopping = false;
+    // The consumer is holding block `consumed` until its next call
+    bool holding = false;
+
+    std::atomic<bool> error{false};
+    std::atomic<size_t> inputRead{0};
+};
+
+// True if the data starts with the gzip magic bytes
+bool isGzipData(std::string_view data);
+
+// `path` without a trailing ".gz", so the inner format can be told from the extension
+std::string stripGzipExtension(const std::string& path);
+
+#endif
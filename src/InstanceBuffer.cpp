@@ -0,0 +1,236 @@
+#include "InstanceBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+// Appearance stream layout: float radius, ubyte palette index, ubyte ambient, 2 bytes padding
+static const size_t appearanceStride = 8;
+
+InstanceBuffer::~InstanceBuffer() {
+    release();
+}
+
+void InstanceBuffer::release() {
+    if (positionVBO != 0) {
+        glDeleteBuffers(1, &positionVBO);
+        glDeleteBuffers(1, &appearanceVBO);
+        glDeleteTextures(1, &positionTexture);
+        glDeleteTextures(1, &appearanceTexture);
+        positionVBO = appearanceVBO = positionTexture = appearanceTexture = 0;
+    }
+    if (paletteTexture != 0) {
+        glDeleteTextures(1, &paletteTexture);
+        glDeleteBuffers(1, &paletteBuffer);
+        paletteTexture = paletteBuffer = 0;
+    }
+    count = 0;
+    capacity = 0;
+    dirtyPositions.clear();
+    dirtyAppearance.clear();
+    ++allocGeneration;
+}
+
+void InstanceBuffer::ensureBuffers() {
+    if (positionVBO == 0) {
+        glGenBuffers(1, &positionVBO);
+        glGenBuffers(1, &appearanceVBO);
+        glGenTextures(1, &positionTexture);
+        glGenTextures(1, &appearanceTexture);
+    }
+}
+
+void InstanceBuffer::allocate(size_t newCapacity) {
+    ensureBuffers();
+    capacity = newCapacity;
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, appearanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * appearanceStride, nullptr, GL_DYNAMIC_DRAW);
+    // Texture views follow the new data stores
+    glBindTexture(GL_TEXTURE_BUFFER, positionTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, positionVBO);
+    glBindTexture(GL_TEXTURE_BUFFER, appearanceTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, appearanceVBO);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    ++allocGeneration;
+}
+
+void InstanceBuffer::upload(const std::vector<SphereInstance>& instances) {
+    // Allocate storage once, then fill it through the same path as partial updates
+    allocate(instances.size());
+    count = instances.size();
+
+    dirtyPositions.clear();
+    dirtyAppearance.clear();
+    uploadPositions(instances, 0, count);
+    uploadAppearance(instances, 0, count);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::append(const std::vector<SphereInstance>& instances) {
+    if (instances.size() < count) {
+        upload(instances);
+        return;
+    }
+    if (instances.size() > capacity) {
+        // Reallocation discards the old contents, so everything is re-uploaded once
+        allocate(std::max(instances.size(), capacity * 2));
+        count = instances.size();
+        uploadPositions(instances, 0, count);
+        uploadAppearance(instances, 0, count);
+    } else {
+        size_t first = count;
+        count = instances.size();
+        uploadPositions(instances, first, count - first);
+        uploadAppearance(instances, first, count - first);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::markPositionsDirty(size_t first, size_t n) {
+    if (n > 0)
+        dirtyPositions.push_back({first, n});
+}
+
+void InstanceBuffer::markAppearanceDirty(size_t first, size_t n) {
+    if (n > 0)
+        dirtyAppearance.push_back({first, n});
+}
+
+void InstanceBuffer::sync(const std::vector<SphereInstance>& instances) {
+    if (dirtyPositions.empty() && dirtyAppearance.empty())
+        return;
+    if (instances.size() != count) {
+        // Instance count changed under us; a full re-upload is the only consistent option
+        upload(instances);
+        return;
+    }
+
+    coalesce(dirtyPositions);
+    for (const Range& r : dirtyPositions)
+        uploadPositions(instances, r.first, r.count);
+    dirtyPositions.clear();
+
+    coalesce(dirtyAppearance);
+    for (const Range& r : dirtyAppearance)
+        uploadAppearance(instances, r.first, r.count);
+    dirtyAppearance.clear();
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::bindAttributes(size_t firstInstance) const {
+    // Position (vec3)
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)(firstInstance * 3 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    // Radius (float)
+    glBindBuffer(GL_ARRAY_BUFFER, appearanceVBO);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, appearanceStride, (void*)(firstInstance * appearanceStride));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    // Palette index (uint)
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_BYTE, appearanceStride, (void*)(firstInstance * appearanceStride + sizeof(float)));
+    glEnableVertexAttribArray(5);
+    glVertexAttribDivisor(5, 1);
+
+    // Ambient light (normalized ubyte)
+    glVertexAttribPointer(7, 1, GL_UNSIGNED_BYTE, GL_TRUE, appearanceStride, (void*)(firstInstance * appearanceStride + sizeof(float) + 1));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::bindInstanceTextures(unsigned int positionUnit, unsigned int appearanceUnit) const {
+    glActiveTexture(GL_TEXTURE0 + positionUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, positionTexture);
+    glActiveTexture(GL_TEXTURE0 + appearanceUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, appearanceTexture);
+}
+
+void InstanceBuffer::beginFrame() {
+    lastFrameBytes = frameBytes;
+    frameBytes = 0;
+}
+
+void InstanceBuffer::uploadPositions(const std::vector<SphereInstance>& instances, size_t first, size_t n) {
+    n = std::min(n, count - std::min(first, count));
+    if (n == 0)
+        return;
+    staging.resize(n * 3);
+    for (size_t i = 0; i < n; ++i) {
+        const glm::vec3& p = instances[first + i].position;
+        staging[i * 3 + 0] = p.x;
+        staging[i * 3 + 1] = p.y;
+        staging[i * 3 + 2] = p.z;
+    }
+    size_t bytes = n * 3 * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * 3 * sizeof(float), bytes, staging.data());
+    frameBytes += bytes;
+}
+
+void InstanceBuffer::uploadAppearance(const std::vector<SphereInstance>& instances, size_t first, size_t n) {
+    n = std::min(n, count - std::min(first, count));
+    if (n == 0)
+        return;
+    appearanceStaging.assign(n * appearanceStride, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const SphereInstance& inst = instances[first + i];
+        uint8_t* record = appearanceStaging.data() + i * appearanceStride;
+        std::memcpy(record, &inst.radius, sizeof(float));
+        record[sizeof(float)] = inst.colorIndex;
+        record[sizeof(float) + 1] = inst.ambient;
+    }
+    size_t bytes = n * appearanceStride;
+    glBindBuffer(GL_ARRAY_BUFFER, appearanceVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * appearanceStride, bytes, appearanceStaging.data());
+    frameBytes += bytes;
+}
+
+void InstanceBuffer::setPalette(const std::vector<glm::vec3>& colors) {
+    if (paletteTexture == 0) {
+        glGenBuffers(1, &paletteBuffer);
+        glGenTextures(1, &paletteTexture);
+    }
+    paletteColors.assign(colors.begin(), colors.begin() + std::min(colors.size(), paletteSize));
+    paletteColors.resize(paletteSize, glm::vec3(1.0f));
+
+    // RGB32F texture buffers need GL 4.0, so pad entries to RGBA
+    std::vector<glm::vec4> texels(paletteSize);
+    for (size_t i = 0; i < paletteSize; ++i)
+        texels[i] = glm::vec4(paletteColors[i], 1.0f);
+    glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    frameBytes += texels.size() * sizeof(glm::vec4);
+}
+
+void InstanceBuffer::bindPalette(unsigned int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+}
+
+// Sorts and merges overlapping or touching ranges so each byte is uploaded at most once
+void InstanceBuffer::coalesce(std::vector<Range>& ranges) {
+    if (ranges.size() < 2)
+        return;
+    std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.first < b.first; });
+    size_t out = 0;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        Range& last = ranges[out];
+        size_t lastEnd = last.first + last.count;
+        if (ranges[i].first <= lastEnd) {
+            last.count = std::max(lastEnd, ranges[i].first + ranges[i].count) - last.first;
+        } else {
+            ranges[++out] = ranges[i];
+        }
+    }
+    ranges.resize(out + 1);
+}
@@ -0,0 +1,113 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "Sphere.h"
+
+// Run of consecutive instances, e.g. the visible part of the structure
+struct InstanceRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// Persistent GPU copy of the sphere instances. The data is split into two streams so that
+// a change to one does not re-upload the other:
+//   positions  - vec3 per instance                               (attribute 3)
+//   appearance - float radius + ubyte palette index + ubyte ambient light per instance
+//                (attributes 4, 5, 7)
+// Colors are fetched in the vertex shader from a small palette texture buffer.
+// The whole store is uploaded once by upload(); afterwards only ranges marked dirty are
+// pushed to the GPU by sync(), so an unchanged scene costs zero bytes per frame.
+class InstanceBuffer {
+public:
+    InstanceBuffer() = default;
+    ~InstanceBuffer();
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // (Re)allocates both streams and uploads every instance
+    void upload(const std::vector<SphereInstance>& instances);
+    // Uploads instances appended since the last upload/append. Storage grows geometrically,
+    // so streaming a file in batches costs amortised O(n) bytes.
+    void append(const std::vector<SphereInstance>& instances);
+    // Flags instance ranges whose data changed on the CPU side
+    void markPositionsDirty(size_t first, size_t count);
+    void markAppearanceDirty(size_t first, size_t count);
+    // Pushes all dirty ranges to the GPU
+    void sync(const std::vector<SphereInstance>& instances);
+
+    // Points instance attributes 3-5 and 7 of the currently bound VAO at this buffer, starting at
+    // instance `firstInstance` (GL 3.3 has no base-instance draws, so ranges are drawn by
+    // re-basing the attribute pointers)
+    void bindAttributes(size_t firstInstance = 0) const;
+    // Binds texture buffer views of the two streams, for shaders that fetch instances by
+    // index instead of through attributes: positions as R32F (3 texels per instance),
+    // appearance as R32UI (radius bits, then palette index in the low byte and ambient
+    // light in the next)
+    void bindInstanceTextures(unsigned int positionUnit, unsigned int appearanceUnit) const;
+
+    // Replaces the color palette (at most paletteSize entries) indexed by colorIndex
+    void setPalette(const std::vector<glm::vec3>& colors);
+    // Binds the palette texture buffer to the given texture unit
+    void bindPalette(unsigned int unit) const;
+    const std::vector<glm::vec3>& palette() const { return paletteColors; }
+
+    static constexpr size_t paletteSize = 256;
+
+    // Deletes the GL buffers and textures and empties the store; the next upload recreates
+    // them. Must run while the context is current (the destructor does the same).
+    void release();
+
+    // Call once per frame before any upload; keeps the previous frame's byte count
+    void beginFrame();
+
+    size_t size() const { return count; }
+    // Bumped every time the GL buffers are reallocated, so VAOs know to re-bind attributes
+    unsigned int generation() const { return allocGeneration; }
+    size_t bytesUploadedLastFrame() const { return lastFrameBytes; }
+    // Counts per-frame uploads made elsewhere on behalf of the instances (the LOD id list),
+    // so bytesUploadedLastFrame() covers all instance traffic
+    void countUpload(size_t bytes) { frameBytes += bytes; }
+    GLuint positionBuffer() const { return positionVBO; }
+
+private:
+    struct Range {
+        size_t first;
+        size_t count;
+    };
+
+    void ensureBuffers();
+    void allocate(size_t newCapacity);
+    void uploadPositions(const std::vector<SphereInstance>& instances, size_t first, size_t n);
+    void uploadAppearance(const std::vector<SphereInstance>& instances, size_t first, size_t n);
+    static void coalesce(std::vector<Range>& ranges);
+
+    GLuint positionVBO = 0;
+    GLuint appearanceVBO = 0;
+    size_t count = 0;
+    size_t capacity = 0;
+    unsigned int allocGeneration = 0;
+
+    std::vector<Range> dirtyPositions;
+    std::vector<Range> dirtyAppearance;
+    // Reused staging memory so partial uploads do not allocate every frame
+    std::vector<float> staging;
+    std::vector<uint8_t> appearanceStaging;
+
+    GLuint positionTexture = 0;
+    GLuint appearanceTexture = 0;
+
+    GLuint paletteBuffer = 0;
+    GLuint paletteTexture = 0;
+    std::vector<glm::vec3> paletteColors;
+
+    size_t frameBytes = 0;
+    size_t lastFrameBytes = 0;
+};
+
+#endif
@@ -0,0 +1,304 @@
+#include "IsoSurface.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// Blocks per parallel task
+static const size_t blocksPerTask = 8;
+
+// ---- Case table ----
+// Cube corner k sits at (k & 1, (k >> 1) & 1, (k >> 2) & 1). The 12 edges join corners
+// that differ in one axis; an edge is named by its lower corner and that axis.
+struct CubeEdge {
+    int corner;
+    int axis;
+};
+
+struct CaseTable {
+    std::array<CubeEdge, 12> edges;
+    // Per corner mask: triangles as edge triples, up to 5 per case
+    std::array<std::vector<std::array<int, 3>>, 256> triangles;
+};
+
+static glm::vec3 cornerPosition(int corner) {
+    return glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+}
+
+// Builds the triangulation of every corner mask. On each cube face, every run of inside
+// corners is cut off by a segment between the two crossed edges bounding it; this depends
+// only on the face's corners, so the cells on both sides of a face agree and the surface
+// has no cracks. Segments are directed so the inside corners lie on their right seen from
+// outside the cube, which chains them into consistently oriented loops; each loop is
+// fanned into triangles.
+static CaseTable buildCaseTable() {
+    CaseTable table;
+    int edgeCount = 0;
+    int edgeId[8][3];
+    for (int corner = 0; corner < 8; ++corner) {
+        for (int axis = 0; axis < 3; ++axis) {
+            edgeId[corner][axis] = -1;
+            if (!(corner & (1 << axis))) {
+                edgeId[corner][axis] = edgeCount;
+                table.edges[edgeCount++] = {corner, axis};
+            }
+        }
+    }
+    auto edgeBetween = [&](int a, int b) {
+        int low = std::min(a, b);
+        int axis = (a ^ b) == 1 ? 0 : (a ^ b) == 2 ? 1 : 2;
+        return edgeId[low][axis];
+    };
+
+    auto onFace = [&](int e, int axis, int side) {
+        return table.edges[e].axis != axis && ((table.edges[e].corner >> axis) & 1) == side;
+    };
+    auto onCommonFace = [&](int e, int f) {
+        for (int axis = 0; axis < 3; ++axis) {
+            for (int side = 0; side < 2; ++side) {
+                if (onFace(e, axis, side) && onFace(f, axis, side))
+                    return true;
+            }
+        }
+        return false;
+    };
+
+    for (int mask = 0; mask < 256; ++mask) {
+        auto inside = [&](int corner) { return (mask >> corner) & 1; };
+        // Every crossed edge lies on two faces: one segment leaves it, the other arrives
+        std::array<int, 12> next;
+        next.fill(-1);
+        for (int axis = 0; axis < 3; ++axis) {
+            int u = 1 << ((axis + 1) % 3);
+            int v = 1 << ((axis + 2) % 3);
+            for (int side = 0; side < 2; ++side) {
+                // Counter-clockwise seen from outside on the far face, clockwise on the near one
+                int base = side << axis;
+                int ring[4] = {base, base | u, base | u | v, base | v};
+                for (int k = 0; k < 4; ++k) {
+                    // Start of a run of inside corners: find its end and join the bounding edges
+                    if (!inside(ring[k]) || inside(ring[(k + 3) % 4]))
+                        continue;
+                    int end = k;
+                    while (inside(ring[(end + 1) % 4]))
+                        end = (end + 1) % 4;
+                    int entry = edgeBetween(ring[(k + 3) % 4], ring[k]);
+                    int exit = edgeBetween(ring[end], ring[(end + 1) % 4]);
+                    if (side == 1)
+                        next[entry] = exit;
+                    else
+                        next[exit] = entry;
+                }
+            }
+        }
+
+        std::array<bool, 12> used{};
+        for (int start = 0; start < 12; ++start) {
+            if (used[start] || next[start] < 0)
+                continue;
+            std::vector<int> loop;
+            for (int current = start; !used[current]; current = next[current]) {
+                loop.push_back(current);
+                used[current] = true;
+            }
+            // Fan from a vertex whose diagonals do not run along a cube face, where they
+            // could coincide with the neighboring cell's triangles
+            size_t m = loop.size();
+            size_t bestStart = 0;
+            int bestCount = static_cast<int>(m);
+            for (size_t first = 0; first < m && bestCount > 0; ++first) {
+                int inFace = 0;
+                for (size_t k = 2; k + 1 < m; ++k)
+                    inFace += onCommonFace(loop[first], loop[(first + k) % m]);
+                if (inFace < bestCount) {
+                    bestCount = inFace;
+                    bestStart = first;
+                }
+            }
+            for (size_t k = 1; k + 1 < m; ++k)
+                table.triangles[mask].push_back({loop[bestStart], loop[(bestStart + k) % m], loop[(bestStart + k + 1) % m]});
+        }
+    }
+    return table;
+}
+
+static const CaseTable& caseTable() {
+    static const CaseTable table = buildCaseTable();
+    return table;
+}
+
+// ---- IsoGrid ----
+void IsoGrid::cover(const glm::vec3& low, const glm::vec3& high, float sampleSpacing) {
+    origin = low;
+    spacing = sampleSpacing;
+    glm::vec3 extent = glm::max(high - low, glm::vec3(0.0f)) / (spacing * blockCells);
+    blocks = glm::max(glm::ivec3(glm::ceil(extent)), glm::ivec3(1));
+}
+
+glm::ivec3 IsoGrid::blockOf(const glm::vec3& p) const {
+    glm::ivec3 block(glm::floor((p - origin) / (spacing * blockCells)));
+    return glm::clamp(block, glm::ivec3(0), blocks - 1);
+}
+
+// ---- Extraction ----
+namespace {
+// Output of one block before welding
+struct BlockMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> colors;
+    // Edges whose vertex this block created, as (local edge key, vertex), sorted by key
+    std::vector<std::pair<uint32_t, uint32_t>> ownedEdges;
+    // Triangle corners: a vertex of this block if ownedFlag is set, else a global edge key
+    std::vector<uint64_t> corners;
+};
+}
+
+static const uint64_t ownedFlag = uint64_t(1) << 63;
+
+static uint32_t localEdgeKey(const glm::ivec3& sample, int axis) {
+    return static_cast<uint32_t>(IsoGrid::localSample(sample.x, sample.y, sample.z) * 3 + axis);
+}
+
+// Shared by both entry points. `sample` fills a block's values and, for shaded samplers,
+// its per-sample normals and colors; `shade` finds the attributes of a vertex at
+// fraction t along the edge from local sample a to b.
+template <typename Sample, typename Shade>
+static void extract(const IsoGrid& grid, const std::vector<uint32_t>& blocks, float isoLevel, const Sample& sample,
+                    const Shade& shade, ThreadPool& pool, SurfaceMesh& mesh) {
+    mesh.clear();
+    const CaseTable& table = caseTable();
+    const glm::ivec3 samples = grid.blocks * IsoGrid::blockCells + 1;
+    auto globalEdgeKey = [&](const glm::ivec3& s, int axis) {
+        return ((static_cast<uint64_t>(s.z) * samples.y + s.y) * samples.x + s.x) * 3 + axis;
+    };
+    // The block that creates the vertex of an edge: the one holding its lower end, except
+    // on the far faces of the grid, which belong to the last block
+    auto ownerOf = [&](const glm::ivec3& s) {
+        return glm::min(s / IsoGrid::blockCells, grid.blocks - 1);
+    };
+
+    // Pass 1: sample every block and triangulate its cells, creating the vertices it owns
+    std::vector<BlockMesh> blockMeshes(blocks.size());
+    pool.parallelFor((blocks.size() + blocksPerTask - 1) / blocksPerTask, [&](size_t task) {
+        std::vector<float> values(IsoGrid::samplesPerBlock);
+        std::vector<glm::vec3> sampleNormals(IsoGrid::samplesPerBlock), sampleColors(IsoGrid::samplesPerBlock);
+        std::vector<int32_t> edgeVertex(IsoGrid::samplesPerBlock * 3, -1);
+        for (size_t b = task * blocksPerTask; b < std::min(blocks.size(), (task + 1) * blocksPerTask); ++b) {
+            const glm::ivec3 block = grid.blockCoordinate(blocks[b]);
+            if (!sample(block, values.data(), sampleNormals.data(), sampleColors.data()))
+                continue;
+            BlockMesh& out = blockMeshes[b];
+            const glm::ivec3 firstSample = block * IsoGrid::blockCells;
+            for (int z = 0; z < IsoGrid::blockCells; ++z) {
+                for (int y = 0; y < IsoGrid::blockCells; ++y) {
+                    for (int x = 0; x < IsoGrid::blockCells; ++x) {
+                        int mask = 0;
+                        for (int corner = 0; corner < 8; ++corner) {
+                            float value = values[IsoGrid::localSample(x + (corner & 1), y + ((corner >> 1) & 1), z + (corner >> 2))];
+                            mask |= (value > isoLevel) << corner;
+                        }
+                        for (const std::array<int, 3>& triangle : table.triangles[mask]) {
+                            for (int e : triangle) {
+                                const CubeEdge& edge = table.edges[e];
+                                glm::ivec3 local = glm::ivec3(x, y, z) + glm::ivec3(cornerPosition(edge.corner));
+                                glm::ivec3 global = firstSample + local;
+                                if (ownerOf(global) != block) {
+                                    out.corners.push_back(globalEdgeKey(global, edge.axis));
+                                    continue;
+                                }
+                                uint32_t key = localEdgeKey(local, edge.axis);
+                                if (edgeVertex[key] < 0) {
+                                    glm::ivec3 step(0);
+                                    step[edge.axis] = 1;
+                                    size_t a = IsoGrid::localSample(local.x, local.y, local.z);
+                                    size_t b = IsoGrid::localSample(local.x + step.x, local.y + step.y, local.z + step.z);
+                                    float t = std::clamp((isoLevel - values[a]) / (values[b] - values[a]), 0.0f, 1.0f);
+                                    glm::vec3 position = glm::mix(grid.samplePosition(global), grid.samplePosition(global + step), t);
+                                    glm::vec3 normal(0.0f), color(1.0f);
+                                    shade(position, a, b, t, sampleNormals, sampleColors, normal, color);
+                                    edgeVertex[key] = static_cast<int32_t>(out.positions.size());
+                                    out.ownedEdges.push_back({key, static_cast<uint32_t>(out.positions.size())});
+                                    out.positions.push_back(position);
+                                    out.normals.push_back(normal);
+                                    out.colors.push_back(color);
+                                }
+                                out.corners.push_back(ownedFlag | static_cast<uint64_t>(edgeVertex[key]));
+                            }
+                        }
+                    }
+                }
+            }
+            for (const auto& [key, vertex] : out.ownedEdges)
+                edgeVertex[key] = -1;
+            std::sort(out.ownedEdges.begin(), out.ownedEdges.end());
+        }
+    });
+
+    // Pass 2: lay the blocks out one after another and resolve edge references
+    std::vector<int32_t> slotOfBlock(grid.blockCount(), -1);
+    for (size_t b = 0; b < blocks.size(); ++b)
+        slotOfBlock[blocks[b]] = static_cast<int32_t>(b);
+    std::vector<size_t> firstVertex(blocks.size() + 1, 0);
+    std::vector<size_t> firstCorner(blocks.size() + 1, 0);
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        firstVertex[b + 1] = firstVertex[b] + blockMeshes[b].positions.size();
+        firstCorner[b + 1] = firstCorner[b] + blockMeshes[b].corners.size();
+    }
+    mesh.positions.resize(firstVertex.back());
+    mesh.normals.resize(firstVertex.back());
+    mesh.colors.resize(firstVertex.back());
+    mesh.indices.resize(firstCorner.back());
+
+    pool.parallelFor((blocks.size() + blocksPerTask - 1) / blocksPerTask, [&](size_t task) {
+        for (size_t b = task * blocksPerTask; b < std::min(blocks.size(), (task + 1) * blocksPerTask); ++b) {
+            BlockMesh& in = blockMeshes[b];
+            std::copy(in.positions.begin(), in.positions.end(), mesh.positions.begin() + firstVertex[b]);
+            std::copy(in.normals.begin(), in.normals.end(), mesh.normals.begin() + firstVertex[b]);
+            std::copy(in.colors.begin(), in.colors.end(), mesh.colors.begin() + firstVertex[b]);
+            for (size_t c = 0; c < in.corners.size(); ++c) {
+                uint64_t corner = in.corners[c];
+                uint32_t index = 0;
+                if (corner & ownedFlag) {
+                    index = static_cast<uint32_t>(firstVertex[b] + (corner & ~ownedFlag));
+                } else {
+                    int axis = static_cast<int>(corner % 3);
+                    uint64_t point = corner / 3;
+                    glm::ivec3 global(static_cast<int>(point % samples.x), static_cast<int>(point / samples.x % samples.y),
+                                      static_cast<int>(point / (static_cast<uint64_t>(samples.x) * samples.y)));
+                    glm::ivec3 owner = ownerOf(global);
+                    int32_t slot = slotOfBlock[grid.blockIndex(owner)];
+                    if (slot >= 0) {
+                        const auto& owned = blockMeshes[slot].ownedEdges;
+                        uint32_t key = localEdgeKey(global - owner * IsoGrid::blockCells, axis);
+                        auto it = std::lower_bound(owned.begin(), owned.end(), std::make_pair(key, 0u));
+                        if (it != owned.end() && it->first == key)
+                            index = static_cast<uint32_t>(firstVertex[slot] + it->second);
+                    }
+                }
+                mesh.indices[firstCorner[b] + c] = index;
+            }
+        }
+    });
+}
+
+void extractIsosurface(const IsoGrid& grid, const std::vector<uint32_t>& blocks, float isoLevel,
+                       const IsoSampler& sample, const IsoShader& shade, ThreadPool& pool, SurfaceMesh& mesh) {
+    extract(grid, blocks, isoLevel,
+            [&](const glm::ivec3& block, float* values, glm::vec3*, glm::vec3*) { return sample(block, values); },
+            [&](const glm::vec3& position, size_t, size_t, float, const std::vector<glm::vec3>&,
+                const std::vector<glm::vec3>&, glm::vec3& normal, glm::vec3& color) { shade(position, normal, color); },
+            pool, mesh);
+}
+
+void extractIsosurface(const IsoGrid& grid, const std::vector<uint32_t>& blocks, float isoLevel,
+                       const IsoShadedSampler& sample, ThreadPool& pool, SurfaceMesh& mesh) {
+    extract(grid, blocks, isoLevel, sample,
+            [](const glm::vec3&, size_t a, size_t b, float t, const std::vector<glm::vec3>& normals,
+               const std::vector<glm::vec3>& colors, glm::vec3& normal, glm::vec3& color) {
+                glm::vec3 n = glm::mix(normals[a], normals[b], t);
+                float length = glm::length(n);
+                normal = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+                color = glm::mix(colors[a], colors[b], t);
+            },
+            pool, mesh);
+}
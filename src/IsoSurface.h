@@ -0,0 +1,82 @@
+#ifndef ISO_SURFACE_H
+#define ISO_SURFACE_H
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "ThreadPool.h"
+
+// Indexed triangle mesh with one normal and color per vertex, wound counter-clockwise seen
+// from outside
+struct SurfaceMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> colors;
+    std::vector<uint32_t> indices;
+
+    void clear() {
+        positions.clear();
+        normals.clear();
+        colors.clear();
+        indices.clear();
+    }
+    size_t vertexCount() const { return positions.size(); }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Regular sample grid split into blocks of blockCells^3 cells. A block holds the
+// blockSamples^3 samples at its cell corners, so neighboring blocks share a face of
+// samples; only blocks near the surface are ever sampled.
+struct IsoGrid {
+    static constexpr int blockCells = 8;
+    static constexpr int blockSamples = blockCells + 1;
+    static constexpr size_t samplesPerBlock = blockSamples * blockSamples * blockSamples;
+
+    glm::vec3 origin{0.0f};
+    float spacing = 1.0f;
+    glm::ivec3 blocks{0};
+
+    // Sets up blocks covering the box [low, high]
+    void cover(const glm::vec3& low, const glm::vec3& high, float sampleSpacing);
+
+    size_t blockCount() const { return static_cast<size_t>(blocks.x) * blocks.y * blocks.z; }
+    size_t blockIndex(const glm::ivec3& block) const {
+        return (static_cast<size_t>(block.z) * blocks.y + block.y) * blocks.x + block.x;
+    }
+    glm::ivec3 blockCoordinate(size_t index) const {
+        return glm::ivec3(static_cast<int>(index % blocks.x), static_cast<int>(index / blocks.x % blocks.y),
+                          static_cast<int>(index / (static_cast<size_t>(blocks.x) * blocks.y)));
+    }
+    // Block containing p, clamped to the grid
+    glm::ivec3 blockOf(const glm::vec3& p) const;
+    // Position of a grid sample. Blocks sharing a sample must compute it through this, so
+    // both see exactly the same position.
+    glm::vec3 samplePosition(const glm::ivec3& sample) const { return origin + glm::vec3(sample) * spacing; }
+    // Index of local sample (x, y, z) of a block within its blockSamples^3 values, x fastest
+    static size_t localSample(int x, int y, int z) { return (static_cast<size_t>(z) * blockSamples + y) * blockSamples + x; }
+};
+
+// Fills the samplesPerBlock values of a block; returns false if the block holds no part of
+// the surface, i.e. all its values lie on one side of the level. A sample shared by two
+// blocks must get the same value from both.
+using IsoSampler = std::function<bool(const glm::ivec3& block, float* values)>;
+// Sets the normal and color of a surface vertex
+using IsoShader = std::function<void(const glm::vec3& position, glm::vec3& normal, glm::vec3& color)>;
+// Sampler that also gives every sample a normal and color, for fields that carry them
+// cheaply alongside the values
+using IsoShadedSampler = std::function<bool(const glm::ivec3& block, float* values, glm::vec3* normals, glm::vec3* colors)>;
+
+// Marching cubes over the given blocks of `grid`, in parallel on `pool`. Values above
+// isoLevel are inside. Each cell edge belongs to the block holding its lower end, which
+// creates the vertex; the other blocks refer to it by edge, and the references are resolved
+// once all blocks are done, so vertices are shared without any locking. `mesh` is
+// replaced by the welded result.
+void extractIsosurface(const IsoGrid& grid, const std::vector<uint32_t>& blocks, float isoLevel,
+                       const IsoSampler& sample, const IsoShader& shade, ThreadPool& pool, SurfaceMesh& mesh);
+// Same, with vertex normals and colors interpolated along the edge between its two samples
+void extractIsosurface(const IsoGrid& grid, const std::vector<uint32_t>& blocks, float isoLevel,
+                       const IsoShadedSampler& sample, ThreadPool& pool, SurfaceMesh& mesh);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. The contents are exposed as a string_view
+// so parsers can decode records in place without copying the file into the heap.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            // We stream through the file front to back
+            madvise(ptr, length, MADV_SEQUENTIAL);
+            base = static_cast<const char*>(ptr);
+        }
+        ::close(fd);
+        isOpen = true;
+        return true;
+    }
+
+    void close() {
+        if (base != nullptr)
+            munmap(const_cast<char*>(base), length);
+        base = nullptr;
+        length = 0;
+        isOpen = false;
+    }
+
+    bool is_open() const { return isOpen; }
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(base != nullptr ? base : "", length); }
+
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    bool isOpen = false;
+};
+#endif
@@ -0,0 +1,355 @@
+#include "MolecularSurface.h"
+#include "Elements.h"
+#include "Sasa.h"
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Blocks of `grid` within reach[i] of some atom i
+std::vector<uint32_t> blocksNear(const IsoGrid& grid, const std::vector<SphereInstance>& instances,
+                                 const std::vector<float>& reach) {
+    std::vector<uint8_t> touched(grid.blockCount(), 0);
+    for (size_t i = 0; i < reach.size(); ++i) {
+        glm::ivec3 first = grid.blockOf(instances[i].position - reach[i]);
+        glm::ivec3 last = grid.blockOf(instances[i].position + reach[i]);
+        for (int z = first.z; z <= last.z; ++z)
+            for (int y = first.y; y <= last.y; ++y)
+                for (int x = first.x; x <= last.x; ++x)
+                    touched[grid.blockIndex(glm::ivec3(x, y, z))] = 1;
+    }
+    std::vector<uint32_t> blocks;
+    for (size_t b = 0; b < touched.size(); ++b) {
+        if (touched[b])
+            blocks.push_back(static_cast<uint32_t>(b));
+    }
+    return blocks;
+}
+
+// Meshes the solvent-accessible spheres, or with `excluded` the space the probe cannot reach
+void buildSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                  const std::vector<glm::vec3>& palette, float resolution, bool excluded, ThreadPool& pool,
+                  SurfaceMesh& mesh) {
+    mesh.clear();
+    size_t n = std::min(structure.size(), instances.size());
+    if (n == 0 || resolution <= 0.0f)
+        return;
+    const float h = resolution;
+    // Field values only matter near the level; further out they are clamped to this
+    const float clampDistance = 2.0f * h;
+
+    // Probe centers about twice as far apart as the samples; the surface between two of
+    // them sags by less than a tenth of an Angstrom at 0.5 A
+    std::vector<glm::vec3> centers;
+    std::vector<uint32_t> centerAtoms;
+    SpatialIndex probes;
+    if (excluded) {
+        accessibleProbeCenters(structure, std::clamp(2.0f * h, 0.5f, 2.0f), pool, centers, centerAtoms);
+        probes.build(centers, probeRadius + clampDistance, pool);
+    }
+
+    // Solvent-accessible spheres
+    std::vector<float> radius(n);
+    float maxRadius = 0.0f;
+    float inf = std::numeric_limits<float>::infinity();
+    glm::vec3 low(inf), high(-inf);
+    for (size_t i = 0; i < n; ++i) {
+        radius[i] = elementInfo(structure.element[i]).vdwRadius + probeRadius;
+        maxRadius = std::max(maxRadius, radius[i]);
+        low = glm::min(low, instances[i].position);
+        high = glm::max(high, instances[i].position);
+    }
+    SpatialIndex atoms;
+    atoms.build(instances, maxRadius, pool);
+
+    // Only blocks within reach of some sphere can hold the surface; the outermost samples
+    // are all outside
+    IsoGrid grid;
+    float margin = maxRadius + 2.0f * clampDistance;
+    grid.cover(low - margin, high + margin, h);
+    std::vector<float> reach(n);
+    for (size_t i = 0; i < n; ++i)
+        reach[i] = radius[i] + clampDistance;
+    std::vector<uint32_t> blocks = blocksNear(grid, instances, reach);
+
+    const float blockHalf = 0.5f * IsoGrid::blockCells * h;
+    const float blockHalfDiagonal = blockHalf * std::sqrt(3.0f);
+    auto sample = [&](const glm::ivec3& block, float* values) {
+        const glm::ivec3 firstSample = block * IsoGrid::blockCells;
+        const glm::vec3 blockLow = grid.samplePosition(firstSample);
+        const glm::vec3 blockCenter = blockLow + glm::vec3(blockHalf);
+        std::vector<uint32_t> candidates;
+        atoms.radiusQuery(blockCenter, blockHalfDiagonal + maxRadius + clampDistance, candidates);
+        if (candidates.empty())
+            return false;
+        // Skip blocks that lie wholly outside the accessible spheres, or so deep inside
+        // that the surface cannot pass through them
+        float centerDistance = inf;
+        for (uint32_t j : candidates)
+            centerDistance = std::min(centerDistance, glm::length(blockCenter - instances[j].position) - radius[j]);
+        float depth = excluded ? probeRadius + clampDistance : 0.0f;
+        if (centerDistance > blockHalfDiagonal || centerDistance < -(depth + blockHalfDiagonal))
+            return false;
+
+        // Sample coordinates along each axis, computed as samplePosition() does
+        float axis[3][IsoGrid::blockSamples];
+        for (int k = 0; k < IsoGrid::blockSamples; ++k) {
+            glm::vec3 p = grid.samplePosition(firstSample + glm::ivec3(k));
+            axis[0][k] = p.x;
+            axis[1][k] = p.y;
+            axis[2][k] = p.z;
+        }
+        auto sampleRange = [&](const glm::vec3& c, float reach, glm::ivec3& first, glm::ivec3& last) {
+            first = glm::max(glm::ivec3(glm::ceil((c - reach - blockLow) / h)), glm::ivec3(0));
+            last = glm::min(glm::ivec3(glm::floor((c + reach - blockLow) / h)), glm::ivec3(IsoGrid::blockCells));
+        };
+
+        // Signed distance to the accessible spheres, splatted atom by atom
+        std::fill(values, values + IsoGrid::samplesPerBlock, clampDistance);
+        for (uint32_t j : candidates) {
+            glm::vec3 c = instances[j].position;
+            glm::ivec3 first, last;
+            sampleRange(c, radius[j] + clampDistance, first, last);
+            for (int z = first.z; z <= last.z; ++z) {
+                float dz = axis[2][z] - c.z;
+                for (int y = first.y; y <= last.y; ++y) {
+                    float dy = axis[1][y] - c.y;
+                    float dyz = dy * dy + dz * dz;
+                    float* row = values + IsoGrid::localSample(0, y, z);
+                    for (int x = first.x; x <= last.x; ++x) {
+                        float dx = axis[0][x] - c.x;
+                        row[x] = std::min(row[x], std::sqrt(dx * dx + dyz) - radius[j]);
+                    }
+                }
+            }
+        }
+
+        bool anyInside = false, anyOutside = false;
+        if (!excluded) {
+            for (size_t s = 0; s < IsoGrid::samplesPerBlock; ++s) {
+                values[s] = -values[s];
+                (values[s] > 0.0f ? anyInside : anyOutside) = true;
+            }
+            return anyInside && anyOutside;
+        }
+
+        // Squared distance to the nearest probe center, splatted the same way; only the
+        // shell of samples just inside the accessible spheres needs it
+        const float probeReach = probeRadius + clampDistance;
+        float probeDistance2[IsoGrid::samplesPerBlock];
+        std::fill(probeDistance2, probeDistance2 + IsoGrid::samplesPerBlock, probeReach * probeReach);
+        candidates.clear();
+        probes.radiusQuery(blockCenter, blockHalfDiagonal + probeReach, candidates);
+        for (uint32_t k : candidates) {
+            glm::vec3 c = centers[k];
+            glm::ivec3 first, last;
+            sampleRange(c, probeReach, first, last);
+            for (int z = first.z; z <= last.z; ++z) {
+                float dz = axis[2][z] - c.z;
+                for (int y = first.y; y <= last.y; ++y) {
+                    float dy = axis[1][y] - c.y;
+                    float dyz = dy * dy + dz * dz;
+                    float* row = probeDistance2 + IsoGrid::localSample(0, y, z);
+                    for (int x = first.x; x <= last.x; ++x) {
+                        float dx = axis[0][x] - c.x;
+                        row[x] = std::min(row[x], dx * dx + dyz);
+                    }
+                }
+            }
+        }
+
+        // Excluded-surface field: positive inside, level at 0
+        for (size_t s = 0; s < IsoGrid::samplesPerBlock; ++s) {
+            float accessible = values[s];
+            if (accessible >= 0.0f)
+                values[s] = -probeRadius - accessible;
+            else if (accessible < -(probeRadius + clampDistance))
+                values[s] = clampDistance;
+            else
+                values[s] = std::min(std::sqrt(probeDistance2[s]) - probeRadius, clampDistance);
+            (values[s] > 0.0f ? anyInside : anyOutside) = true;
+        }
+        return anyInside && anyOutside;
+    };
+
+    auto colorOf = [&](uint32_t atom) {
+        uint8_t index = instances[atom].colorIndex;
+        return index < palette.size() ? palette[index] : glm::vec3(0.8f);
+    };
+    auto shade = [&](const glm::vec3& position, glm::vec3& normal, glm::vec3& color) {
+        if (excluded) {
+            int64_t k = probes.nearestWithin(position, probeRadius + clampDistance);
+            if (k >= 0) {
+                normal = glm::normalize(centers[k] - position);
+                color = colorOf(centerAtoms[k]);
+                return;
+            }
+        }
+        // The sphere the vertex lies on: least distance to its surface, not to its center
+        std::vector<uint32_t> nearby;
+        atoms.radiusQuery(position, maxRadius + clampDistance, nearby);
+        int64_t a = -1;
+        float best = inf;
+        for (uint32_t j : nearby) {
+            float distance = glm::length(position - instances[j].position) - radius[j];
+            if (distance < best) {
+                best = distance;
+                a = j;
+            }
+        }
+        normal = a >= 0 ? glm::normalize(position - instances[a].position) : glm::vec3(0.0f, 1.0f, 0.0f);
+        color = a >= 0 ? colorOf(static_cast<uint32_t>(a)) : glm::vec3(0.8f);
+    };
+
+    extractIsosurface(grid, blocks, 0.0f, sample, shade, pool, mesh);
+}
+
+} // namespace
+
+void buildSolventExcludedSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                                 const std::vector<glm::vec3>& palette, float resolution, ThreadPool& pool,
+                                 SurfaceMesh& mesh) {
+    buildSurface(structure, instances, palette, resolution, true, pool, mesh);
+}
+
+void buildSolventAccessibleSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                                   const std::vector<glm::vec3>& palette, float resolution, ThreadPool& pool,
+                                   SurfaceMesh& mesh) {
+    buildSurface(structure, instances, palette, resolution, false, pool, mesh);
+}
+
+void buildGaussianSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                          const std::vector<glm::vec3>& palette, float resolution, float width, ThreadPool& pool,
+                          SurfaceMesh& mesh) {
+    mesh.clear();
+    size_t n = std::min(structure.size(), instances.size());
+    if (n == 0 || resolution <= 0.0f || width <= 0.0f)
+        return;
+    const float h = resolution;
+    // An isolated atom's density falls to the level at its van der Waals radius
+    const float isoLevel = std::exp(-0.5f / (width * width));
+
+    // Per-atom Gaussian exponent and cutoff; an atom is dropped where it adds less than
+    // cutoffFraction of the level
+    const float cutoffFraction = 0.01f;
+    const float cutoffScale = std::sqrt(1.0f + 2.0f * width * width * std::log(1.0f / cutoffFraction));
+    std::vector<float> falloff(n), cutoff(n);
+    float maxCutoff = 0.0f;
+    float inf = std::numeric_limits<float>::infinity();
+    glm::vec3 low(inf), high(-inf);
+    for (size_t i = 0; i < n; ++i) {
+        float vdwRadius = elementInfo(structure.element[i]).vdwRadius;
+        float sigma = width * vdwRadius;
+        falloff[i] = 0.5f / (sigma * sigma);
+        cutoff[i] = cutoffScale * vdwRadius;
+        maxCutoff = std::max(maxCutoff, cutoff[i]);
+        low = glm::min(low, instances[i].position);
+        high = glm::max(high, instances[i].position);
+    }
+    IsoGrid grid;
+    grid.cover(low - (maxCutoff + h), high + (maxCutoff + h), h);
+
+    // Atoms whose cutoff box overlaps each block, in compressed sparse rows. Scattering
+    // atoms in index order lists every block's atoms in index order, so two blocks sharing
+    // a sample sum its terms in the same order and agree on its value.
+    std::vector<uint32_t> blockOffsets(grid.blockCount() + 1, 0);
+    auto forEachBlockOf = [&](size_t i, auto&& visit) {
+        glm::ivec3 first = grid.blockOf(instances[i].position - cutoff[i]);
+        glm::ivec3 last = grid.blockOf(instances[i].position + cutoff[i]);
+        for (int z = first.z; z <= last.z; ++z)
+            for (int y = first.y; y <= last.y; ++y)
+                for (int x = first.x; x <= last.x; ++x)
+                    visit(grid.blockIndex(glm::ivec3(x, y, z)));
+    };
+    for (size_t i = 0; i < n; ++i)
+        forEachBlockOf(i, [&](size_t b) { ++blockOffsets[b + 1]; });
+    std::vector<uint32_t> blocks;
+    for (size_t b = 0; b < grid.blockCount(); ++b) {
+        if (blockOffsets[b + 1] > 0)
+            blocks.push_back(static_cast<uint32_t>(b));
+        blockOffsets[b + 1] += blockOffsets[b];
+    }
+    std::vector<uint32_t> blockAtoms(blockOffsets.back());
+    {
+        std::vector<uint32_t> fill(blockOffsets.begin(), blockOffsets.end() - 1);
+        for (size_t i = 0; i < n; ++i)
+            forEachBlockOf(i, [&](size_t b) { blockAtoms[fill[b]++] = static_cast<uint32_t>(i); });
+    }
+
+    std::vector<glm::vec3> atomColor(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t index = instances[i].colorIndex;
+        atomColor[i] = index < palette.size() ? palette[index] : glm::vec3(0.8f);
+    }
+
+    // Along with the density, every sample sums the density gradient for its normal and
+    // the atom colors weighted by their share of the density
+    auto sample = [&](const glm::ivec3& block, float* values, glm::vec3* normals, glm::vec3* colors) {
+        size_t b = grid.blockIndex(block);
+        const glm::ivec3 firstSample = block * IsoGrid::blockCells;
+        const glm::vec3 blockLow = grid.samplePosition(firstSample);
+        float axis[3][IsoGrid::blockSamples];
+        for (int k = 0; k < IsoGrid::blockSamples; ++k) {
+            glm::vec3 p = grid.samplePosition(firstSample + glm::ivec3(k));
+            axis[0][k] = p.x;
+            axis[1][k] = p.y;
+            axis[2][k] = p.z;
+        }
+
+        // The Gaussian separates into one factor per axis, so each atom costs a few
+        // exponentials per axis and a product per sample. The sample range is padded by
+        // one so rounding never drops a sample; the distance test decides.
+        std::fill(values, values + IsoGrid::samplesPerBlock, 0.0f);
+        std::fill(normals, normals + IsoGrid::samplesPerBlock, glm::vec3(0.0f));
+        std::fill(colors, colors + IsoGrid::samplesPerBlock, glm::vec3(0.0f));
+        float factor[3][IsoGrid::blockSamples];
+        float offset[3][IsoGrid::blockSamples];
+        for (uint32_t k = blockOffsets[b]; k < blockOffsets[b + 1]; ++k) {
+            uint32_t j = blockAtoms[k];
+            glm::vec3 c = instances[j].position;
+            float cutoff2 = cutoff[j] * cutoff[j];
+            glm::ivec3 first = glm::max(glm::ivec3(glm::floor((c - cutoff[j] - blockLow) / h)), glm::ivec3(0));
+            glm::ivec3 last = glm::min(glm::ivec3(glm::ceil((c + cutoff[j] - blockLow) / h)), glm::ivec3(IsoGrid::blockCells));
+            for (int a = 0; a < 3; ++a) {
+                for (int s = first[a]; s <= last[a]; ++s) {
+                    offset[a][s] = axis[a][s] - c[a];
+                    factor[a][s] = std::exp(-falloff[j] * offset[a][s] * offset[a][s]);
+                }
+            }
+            // The gradient points outward, down the density slope
+            const float slope = 2.0f * falloff[j];
+            const glm::vec3 color = atomColor[j];
+            for (int z = first.z; z <= last.z; ++z) {
+                for (int y = first.y; y <= last.y; ++y) {
+                    float dy = offset[1][y], dz = offset[2][z];
+                    float dyz = dy * dy + dz * dz;
+                    if (dyz >= cutoff2)
+                        continue;
+                    float fyz = factor[1][y] * factor[2][z];
+                    size_t row = IsoGrid::localSample(0, y, z);
+                    for (int x = first.x; x <= last.x; ++x) {
+                        float dx = offset[0][x];
+                        if (dx * dx + dyz >= cutoff2)
+                            continue;
+                        float density = factor[0][x] * fyz;
+                        values[row + x] += density;
+                        normals[row + x] += (slope * density) * glm::vec3(dx, dy, dz);
+                        colors[row + x] += density * color;
+                    }
+                }
+            }
+        }
+
+        bool anyInside = false, anyOutside = false;
+        for (size_t s = 0; s < IsoGrid::samplesPerBlock; ++s) {
+            if (values[s] > 0.0f)
+                colors[s] /= values[s];
+            (values[s] > isoLevel ? anyInside : anyOutside) = true;
+        }
+        return anyInside && anyOutside;
+    };
+
+    extractIsosurface(grid, blocks, isoLevel, IsoShadedSampler(sample), pool, mesh);
+}
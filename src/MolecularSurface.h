@@ -0,0 +1,44 @@
+#ifndef MOLECULAR_SURFACE_H
+#define MOLECULAR_SURFACE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "IsoSurface.h"
+#include "Sphere.h"
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Solvent-excluded (Connolly) surface of the atoms in `instances`, meshed with
+// `resolution` Angstrom grid spacing. Atom radii are the van der Waals radii of the
+// structure's elements, whatever size the atoms are drawn at.
+//
+// The surface is the boundary of the space a probe sphere (Sasa.h) cannot reach: a point is
+// excluded unless it lies within the probe radius of an accessible probe center. The field
+// sampled is the distance to the nearest accessible center minus the probe radius, which
+// only matters in the shell just inside the solvent-accessible surface; samples outside
+// it or deeper in are classified from the atom spheres alone. Both distances are splatted
+// sphere by sphere into each block of samples, and blocks away from the surface are
+// skipped without being sampled.
+// Vertex normals point at the nearest probe center, which is exact for both the atom and
+// the probe patches, and vertices take the palette color of the atom that center touches.
+void buildSolventExcludedSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                                 const std::vector<glm::vec3>& palette, float resolution, ThreadPool& pool,
+                                 SurfaceMesh& mesh);
+
+// Solvent-accessible surface: the boundary of the atom spheres grown by the probe radius,
+// traced by the probe center. Normals and colors come from the sphere each vertex lies on.
+void buildSolventAccessibleSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                                   const std::vector<glm::vec3>& palette, float resolution, ThreadPool& pool,
+                                   SurfaceMesh& mesh);
+
+// Gaussian density ("quick") surface, cheap enough to rebuild every trajectory frame. Each
+// atom adds a Gaussian of standard deviation `width` times its van der Waals radius,
+// truncated where it falls to 1% of the level, and the level is set so an isolated atom's
+// surface lies at its van der Waals radius; wider Gaussians blur the atoms into smoother blobs.
+// Every grid sample also sums the density gradient and the atom colors weighted by their
+// share of the density; vertices interpolate both from the two samples of their edge.
+void buildGaussianSurface(const Structure& structure, const std::vector<SphereInstance>& instances,
+                          const std::vector<glm::vec3>& palette, float resolution, float width, ThreadPool& pool,
+                          SurfaceMesh& mesh);
+
+#endif
@@ -0,0 +1,226 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+
+// Clusters per visibility test task
+static const size_t testBlockSize = 4096;
+
+OcclusionCuller::OcclusionCuller()
+    : downsampleShader("shaders/hizVertex.glsl", "shaders/hizDownsampleFragment.glsl") {
+    glGenVertexArrays(1, &emptyVAO);
+    glGenFramebuffers(1, &sceneFBO);
+    glGenFramebuffers(1, &pyramidFBO);
+    downsampleShader.use();
+    downsampleShader.setInt("source", 0);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteFramebuffers(1, &sceneFBO);
+    glDeleteFramebuffers(1, &pyramidFBO);
+    if (sceneColor != 0) {
+        glDeleteRenderbuffers(1, &sceneColor);
+        glDeleteTextures(1, &sceneDepth);
+        glDeleteTextures(1, &pyramidTexture);
+    }
+}
+
+void OcclusionCuller::reset() {
+    history.clear();
+    lastFirstPass = 0;
+    lastSecondPass = 0;
+    lastOccluded = 0;
+}
+
+void OcclusionCuller::allocate(int width, int height) {
+    if (sceneColor == 0) {
+        glGenRenderbuffers(1, &sceneColor);
+        glGenTextures(1, &sceneDepth);
+        glGenTextures(1, &pyramidTexture);
+    }
+    sceneWidth = width;
+    sceneHeight = height;
+
+    glBindRenderbuffer(GL_RENDERBUFFER, sceneColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColor);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Occlusion scene target is not complete!" << std::endl;
+
+    // Pyramid: one R32F level per halving of the scene, down to 1x1
+    levels.clear();
+    int w = width, h = height;
+    while (w > 1 || h > 1) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+        levels.push_back({w, h, {}});
+    }
+    pyramidLevels = static_cast<int>(levels.size());
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    for (int k = 0; k < pyramidLevels; ++k)
+        glTexImage2D(GL_TEXTURE_2D, k, GL_R32F, levels[k].width, levels[k].height, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    firstReadLevel = 0;
+    while (firstReadLevel < pyramidLevels - 1 && levels[firstReadLevel].width > readbackWidth)
+        ++firstReadLevel;
+    for (int k = firstReadLevel; k < pyramidLevels; ++k)
+        levels[k].depth.resize(static_cast<size_t>(levels[k].width) * levels[k].height);
+}
+
+void OcclusionCuller::beginScene(int width, int height, const glm::vec4& clearColor) {
+    if (width != sceneWidth || height != sceneHeight)
+        allocate(width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glViewport(0, 0, width, height);
+    glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void OcclusionCuller::endScene() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, sceneWidth, sceneHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OcclusionCuller::firstPass(const ClusterBVH& bvh, std::vector<uint8_t>& flags) {
+    const std::vector<uint8_t>& inFrustum = bvh.frustumVisible();
+    // A new structure starts with no history: everything goes through the second pass
+    if (history.size() != inFrustum.size())
+        history.assign(inFrustum.size(), 0);
+    flags.resize(inFrustum.size());
+    lastFirstPass = 0;
+    for (size_t c = 0; c < inFrustum.size(); ++c) {
+        flags[c] = inFrustum[c] & history[c];
+        lastFirstPass += flags[c];
+    }
+}
+
+// Max-reduces the scene depth into the pyramid, then reads back the coarse levels
+void OcclusionCuller::buildPyramid() {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+
+    downsampleShader.use();
+    glBindVertexArray(emptyVAO);
+    glBindFramebuffer(GL_FRAMEBUFFER, pyramidFBO);
+    glActiveTexture(GL_TEXTURE0);
+    for (int k = 0; k < pyramidLevels; ++k) {
+        // Level 0 reads the depth buffer; later levels read the previous level, which is
+        // made the only sampleable level so reading and writing never overlap
+        if (k == 0) {
+            glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, k - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, k - 1);
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, k);
+        glViewport(0, 0, levels[k].width, levels[k].height);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // The tests run on the CPU; only the small levels come back
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    for (int k = firstReadLevel; k < pyramidLevels; ++k) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, k);
+        glReadPixels(0, 0, levels[k].width, levels[k].height, GL_RED, GL_FLOAT, levels[k].depth.data());
+    }
+
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
+
+bool OcclusionCuller::mayBeVisible(const ClusterBVH::Bounds& bounds, const glm::mat4& viewProjection) const {
+    if (pyramidLevels == 0)
+        return true;
+
+    // Screen rectangle and nearest depth of the box
+    glm::vec2 lo(1.0f), hi(-1.0f);
+    float nearest = 1.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 p = viewProjection * glm::vec4(corner & 1 ? bounds.max.x : bounds.min.x,
+                                                 corner & 2 ? bounds.max.y : bounds.min.y,
+                                                 corner & 4 ? bounds.max.z : bounds.min.z, 1.0f);
+        // Boxes reaching behind the eye cannot be projected; keep them
+        if (p.w <= 1e-5f)
+            return true;
+        glm::vec3 ndc = glm::vec3(p) / p.w;
+        lo = glm::min(lo, glm::vec2(ndc));
+        hi = glm::max(hi, glm::vec2(ndc));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    lo = glm::clamp(lo, glm::vec2(-1.0f), glm::vec2(1.0f));
+    hi = glm::clamp(hi, glm::vec2(-1.0f), glm::vec2(1.0f));
+
+    // Pick the level where the rectangle covers about 2x2 texels
+    float pixelsX = (hi.x - lo.x) * 0.5f * sceneWidth;
+    float pixelsY = (hi.y - lo.y) * 0.5f * sceneHeight;
+    float extent = std::max(pixelsX, pixelsY);
+    int level = extent > 2.0f ? static_cast<int>(std::ceil(std::log2(extent * 0.5f))) - 1 : 0;
+    level = std::clamp(level, firstReadLevel, pyramidLevels - 1);
+    const Level& l = levels[level];
+
+    // Level k texels are 2^(k+1) screen pixels; the last row/column absorbs odd leftovers
+    float scale = 1.0f / static_cast<float>(1 << (level + 1));
+    int x0 = std::min(l.width - 1, static_cast<int>((lo.x * 0.5f + 0.5f) * sceneWidth * scale));
+    int x1 = std::min(l.width - 1, static_cast<int>((hi.x * 0.5f + 0.5f) * sceneWidth * scale));
+    int y0 = std::min(l.height - 1, static_cast<int>((lo.y * 0.5f + 0.5f) * sceneHeight * scale));
+    int y1 = std::min(l.height - 1, static_cast<int>((hi.y * 0.5f + 0.5f) * sceneHeight * scale));
+    float farthest = 0.0f;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x)
+            farthest = std::max(farthest, l.depth[static_cast<size_t>(y) * l.width + x]);
+    }
+    return nearest <= farthest;
+}
+
+void OcclusionCuller::secondPass(const ClusterBVH& bvh, const glm::mat4& viewProjection, ThreadPool& pool,
+                                 std::vector<uint8_t>& flags) {
+    buildPyramid();
+
+    const std::vector<uint8_t>& inFrustum = bvh.frustumVisible();
+    size_t clusters = inFrustum.size();
+    size_t blocks = (clusters + testBlockSize - 1) / testBlockSize;
+    std::vector<size_t> blockSecond(blocks, 0), blockOccluded(blocks, 0);
+    pool.parallelFor(blocks, [&](size_t b) {
+        size_t end = std::min(clusters, (b + 1) * testBlockSize);
+        for (size_t c = b * testBlockSize; c < end; ++c) {
+            bool visible = inFrustum[c] && mayBeVisible(bvh.bounds(c), viewProjection);
+            bool drawn = flags[c] != 0;
+            blockOccluded[b] += inFrustum[c] && !visible;
+            // Second pass: newly visible clusters only; the first pass drew the rest
+            flags[c] = visible && !drawn;
+            blockSecond[b] += flags[c];
+            history[c] = visible;
+        }
+    });
+    lastSecondPass = 0;
+    lastOccluded = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        lastSecondPass += blockSecond[b];
+        lastOccluded += blockOccluded[b];
+    }
+}
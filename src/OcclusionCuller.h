@@ -0,0 +1,85 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "shader.h"
+#include "ClusterBVH.h"
+#include "ThreadPool.h"
+
+// Two-pass hierarchical-Z occlusion culling of BVH clusters:
+//   1. draw the clusters that were visible last frame,
+//   2. build a max-depth pyramid from that depth buffer (fragment shader reductions),
+//   3. test every cluster in the frustum against it and draw the ones that became visible.
+// The result of step 3 is the visibility history for the next frame. The scene is drawn
+// into an offscreen target so its depth can be sampled; endScene() copies it to the
+// window. GL 3.3 has no compute shaders or indirect draws, so the pyramid's coarse levels
+// are read back and the cluster tests run on the thread pool.
+class OcclusionCuller
+{
+public:
+    OcclusionCuller();
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Binds and clears the offscreen target, (re)allocating it for the framebuffer size
+    void beginScene(int width, int height, const glm::vec4& clearColor);
+    // Copies the offscreen color to the default framebuffer and binds it again
+    void endScene();
+
+    // Flags of the clusters to draw in the first pass: in the frustum and visible last frame
+    void firstPass(const ClusterBVH& bvh, std::vector<uint8_t>& flags);
+    // Builds the pyramid from the depth drawn so far, tests the frustum-visible clusters and
+    // flags those to draw in the second pass (visible now, not drawn in the first)
+    void secondPass(const ClusterBVH& bvh, const glm::mat4& viewProjection, ThreadPool& pool,
+                    std::vector<uint8_t>& flags);
+
+    // Forgets the visibility history, e.g. when a new structure is loaded
+    void reset();
+
+    // Cluster counts of the last frame
+    size_t firstPassClusters() const { return lastFirstPass; }
+    size_t secondPassClusters() const { return lastSecondPass; }
+    size_t occludedClusters() const { return lastOccluded; }
+
+    // Smallest pyramid level read back is at most this wide
+    static constexpr int readbackWidth = 256;
+
+private:
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+
+    void allocate(int width, int height);
+    void buildPyramid();
+    // False if the box is certainly hidden behind what the pyramid holds
+    bool mayBeVisible(const ClusterBVH::Bounds& bounds, const glm::mat4& viewProjection) const;
+
+    Shader downsampleShader;
+    GLuint emptyVAO = 0;
+    GLuint sceneFBO = 0;
+    GLuint sceneColor = 0;
+    GLuint sceneDepth = 0;
+    GLuint pyramidFBO = 0;
+    GLuint pyramidTexture = 0;
+    int sceneWidth = 0;
+    int sceneHeight = 0;
+    int pyramidLevels = 0;
+    // Pyramid level k is the scene size halved k + 1 times
+    std::vector<Level> levels;
+    int firstReadLevel = 0;
+
+    std::vector<uint8_t> history;
+    size_t lastFirstPass = 0;
+    size_t lastSecondPass = 0;
+    size_t lastOccluded = 0;
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "PDBParser.h"
+#include "Elements.h"
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+// ---- Column helpers ----
+// Columns are 0-based here; the PDB spec numbers them from 1
+static inline std::string_view column(std::string_view line, size_t start, size_t length) {
+    if (start >= line.size())
+        return std::string_view();
+    return line.substr(start, length);
+}
+
+static inline std::string_view trim(std::string_view field) {
+    size_t begin = 0;
+    size_t end = field.size();
+    while (begin < end && field[begin] == ' ')
+        ++begin;
+    while (end > begin && field[end - 1] == ' ')
+        --end;
+    return field.substr(begin, end - begin);
+}
+
+static inline char toUpper(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool parseFixedFloat(std::string_view field, float& value) {
+    // Fastest path: the %8.3f layout of PDB coordinates, "-123.456" with the point in column 5
+    if (field.size() == 8 && field[4] == '.' && isDigit(field[3]) &&
+        isDigit(field[5]) && isDigit(field[6]) && isDigit(field[7])) {
+        // Written without data-dependent branches; coordinate signs are unpredictable
+        int whole = 0;
+        bool negative = false;
+        bool valid = true;
+        for (int i = 0; i < 4; ++i) {
+            char c = field[i];
+            unsigned digit = static_cast<unsigned>(c - '0');
+            bool isDigitChar = digit < 10;
+            whole = isDigitChar ? whole * 10 + static_cast<int>(digit) : whole;
+            negative |= c == '-';
+            valid &= isDigitChar || c == ' ' || c == '-';
+        }
+        if (valid) {
+            int fraction = (field[5] - '0') * 100 + (field[6] - '0') * 10 + (field[7] - '0');
+            double v = (whole * 1000 + fraction) / 1000.0;
+            value = static_cast<float>(negative ? -v : v);
+            return true;
+        }
+    }
+
+    field = trim(field);
+    if (field.empty())
+        return false;
+
+    // Fast path: [-+]digits[.digits], which covers every coordinate a PDB writer emits
+    size_t i = 0;
+    bool negative = false;
+    if (field[0] == '-' || field[0] == '+') {
+        negative = field[0] == '-';
+        ++i;
+    }
+    long long mantissa = 0;
+    int fractionDigits = 0;
+    bool seenDot = false;
+    bool seenDigit = false;
+    for (; i < field.size(); ++i) {
+        char c = field[i];
+        if (c >= '0' && c <= '9') {
+            if (mantissa > 100000000000000LL)
+                break; // too many digits for the fast path
+            mantissa = mantissa * 10 + (c - '0');
+            seenDigit = true;
+            if (seenDot)
+                ++fractionDigits;
+        } else if (c == '.' && !seenDot) {
+            seenDot = true;
+        } else {
+            break;
+        }
+    }
+    if (i == field.size() && seenDigit) {
+        static const double powersOfTen[] = {
+            1.0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+            1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+        };
+        double v = static_cast<double>(mantissa) / powersOfTen[fractionDigits];
+        value = static_cast<float>(negative ? -v : v);
+        return true;
+    }
+
+    // Slow path: exponents and other unusual spellings
+    const char* first = field.data();
+    if (*first == '+')
+        ++first;
+    auto result = std::from_chars(first, field.data() + field.size(), value);
+    return result.ec == std::errc();
+}
+
+// Decodes a right-justified integer field. Serial numbers beyond 99,999 use the
+// hybrid-36 encoding ("A0000" follows "99999"), which is handled for 5-column fields.
+static bool parseFixedInt(std::string_view field, int32_t& value) {
+    field = trim(field);
+    if (field.empty())
+        return false;
+    char lead = field[0];
+    if (field.size() == 5 && ((lead >= 'A' && lead <= 'Z') || (lead >= 'a' && lead <= 'z'))) {
+        bool upper = lead <= 'Z';
+        int32_t decoded = 0;
+        for (char c : field) {
+            int digit;
+            if (c >= '0' && c <= '9')
+                digit = c - '0';
+            else if (upper && c >= 'A' && c <= 'Z')
+                digit = c - 'A' + 10;
+            else if (!upper && c >= 'a' && c <= 'z')
+                digit = c - 'a' + 10;
+            else
+                return false;
+            decoded = decoded * 36 + digit;
+        }
+        const int32_t base = 10 * 36 * 36 * 36 * 36; // value of "A0000"
+        value = decoded - base + 100000 + (upper ? 0 : 26 * 36 * 36 * 36 * 36);
+        return true;
+    }
+    const char* first = field.data();
+    if (*first == '+')
+        ++first;
+    auto result = std::from_chars(first, field.data() + field.size(), value);
+    return result.ec == std::errc();
+}
+
+static inline char columnChar(std::string_view line, size_t index) {
+    return index < line.size() ? line[index] : ' ';
+}
+
+template <size_t N>
+static inline std::array<char, N> columnText(std::string_view line, size_t start) {
+    std::array<char, N> text;
+    for (size_t i = 0; i < N; ++i)
+        text[i] = columnChar(line, start + i);
+    return text;
+}
+
+// Columns 77-78 hold the element symbol. Old files leave them blank, in which case the
+// symbol is taken from the atom name (columns 13-14) the way the PDB format defines it.
+static uint8_t decodeElement(std::string_view line) {
+    std::string_view symbol = trim(column(line, 76, 2));
+    if (symbol.empty()) {
+        // A name like " CA " is carbon alpha; only a name starting in column 13 has a 2-letter element
+        std::string_view name = column(line, 12, 2);
+        if (name.size() == 2 && (name[0] == ' ' || (name[0] >= '0' && name[0] <= '9')))
+            symbol = name.substr(1, 1);
+        else
+            symbol = trim(name);
+    }
+    char first = symbol.size() > 0 ? toUpper(symbol[0]) : ' ';
+    char second = symbol.size() > 1 ? toUpper(symbol[1]) : ' ';
+    return elementFromSymbol(first, second);
+}
+
+size_t parsePDBAtoms(std::string_view text, Structure& structure) {
+    size_t before = structure.size();
+    const char* cursor = text.data();
+    const char* end = text.data() + text.size();
+    // PDB lines are 80 columns wide, which bounds the record count from above
+    structure.reserve(before + text.size() / 81 + 1);
+
+    while (cursor < end) {
+        const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        const char* lineEnd = newline != nullptr ? newline : end;
+        std::string_view line(cursor, lineEnd - cursor);
+        cursor = newline != nullptr ? newline + 1 : end;
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if (line.compare(0, 6, "MODEL ") == 0) {
+            int32_t serial = 0;
+            parseFixedInt(column(line, 10, 4), serial);
+            structure.models.push_back({structure.size(), serial, 0});
+            continue;
+        }
+        if (line.compare(0, 6, "CONECT") == 0) {
+            // Columns 7-11 name the atom, 12-31 up to four atoms bonded to it
+            int32_t serial = 0;
+            if (!parseFixedInt(column(line, 6, 5), serial))
+                continue;
+            for (size_t start = 11; start < 31; start += 5) {
+                int32_t bonded = 0;
+                if (parseFixedInt(column(line, start, 5), bonded) && bonded != serial)
+                    structure.conect.push_back({serial, bonded});
+            }
+            continue;
+        }
+        bool isHelix = line.compare(0, 6, "HELIX ") == 0;
+        if (isHelix || line.compare(0, 6, "SHEET ") == 0) {
+            // HELIX: chain, number and insertion code of the first residue in columns 20,
+            // 22-25 and 26, of the last in 32, 34-37 and 38. SHEET has the first residue in
+            // columns 22, 23-26 and 27 and the last in the same columns as HELIX.
+            size_t chainColumn = isHelix ? 19 : 21;
+            size_t firstColumn = isHelix ? 21 : 22;
+            SecondaryRange range{};
+            if (line.size() < 38 || !parseFixedInt(column(line, firstColumn, 4), range.firstResidue) ||
+                !parseFixedInt(column(line, 33, 4), range.lastResidue))
+                continue;
+            range.chain = {line[chainColumn], ' ', ' ', ' '};
+            range.firstInsertion = line[firstColumn + 4];
+            range.lastInsertion = line[37];
+            range.type = isHelix ? SecondaryHelix : SecondaryStrand;
+            structure.secondary.push_back(range);
+            continue;
+        }
+        if (line.size() < 54)
+            continue;
+        bool isAtom = line.compare(0, 6, "ATOM  ") == 0;
+        if (!isAtom && line.compare(0, 6, "HETATM") != 0)
+            continue;
+
+        float x, y, z;
+        if (!parseFixedFloat(line.substr(30, 8), x) ||
+            !parseFixedFloat(line.substr(38, 8), y) ||
+            !parseFixedFloat(line.substr(46, 8), z))
+            continue; // malformed coordinates, skip the record
+
+        int32_t serial = 0;
+        if (!parseFixedInt(line.substr(6, 5), serial))
+            serial = structure.serial.empty() ? 1 : structure.serial.back() + 1;
+        int32_t residueNumber = 0;
+        parseFixedInt(line.substr(22, 4), residueNumber);
+        float occupancy = 1.0f;
+        parseFixedFloat(column(line, 54, 6), occupancy);
+        float bFactor = 0.0f;
+        parseFixedFloat(column(line, 60, 6), bFactor);
+
+        structure.x.push_back(x);
+        structure.y.push_back(y);
+        structure.z.push_back(z);
+        structure.element.push_back(decodeElement(line));
+        structure.serial.push_back(serial);
+        structure.atomName.push_back(columnText<4>(line, 12));
+        structure.altLoc.push_back(line[16]);
+        structure.residueName.push_back(columnText<3>(line, 17));
+        structure.residueNumber.push_back(residueNumber);
+        structure.insertionCode.push_back(line[26]);
+        structure.chain.push_back({line[21], ' ', ' ', ' '});
+        structure.occupancy.push_back(occupancy);
+        structure.bFactor.push_back(bFactor);
+        structure.hetero.push_back(isAtom ? 0 : 1);
+    }
+    return structure.size() - before;
+}
+
+std::vector<std::string_view> splitPDBText(std::string_view text, size_t pieces) {
+    std::vector<std::string_view> chunks;
+    size_t target = text.size() / std::max<size_t>(pieces, 1) + 1;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = begin + target;
+        if (end >= text.size()) {
+            end = text.size();
+        } else {
+            size_t newline = text.find('\n', end);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+size_t parsePDBAtomsParallel(std::string_view text, Structure& structure, ThreadPool& pool) {
+    // Small files are not worth the hand-off; 4 MB per chunk keeps each task well above
+    // the scheduling cost while leaving several chunks per thread for load balancing
+    const size_t minChunkBytes = 4u << 20;
+    size_t pieces = std::min<size_t>(pool.size() * 4, text.size() / minChunkBytes);
+    if (pieces <= 1)
+        return parsePDBAtoms(text, structure);
+
+    std::vector<std::string_view> chunks = splitPDBText(text, pieces);
+    std::vector<Structure> buffers(chunks.size());
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        parsePDBAtoms(chunks[i], buffers[i]);
+    });
+
+    // Merge in chunk order; each chunk copies into its own slice of the output
+    size_t before = structure.size();
+    std::vector<size_t> offsets(buffers.size() + 1, before);
+    for (size_t i = 0; i < buffers.size(); ++i)
+        offsets[i + 1] = offsets[i] + buffers[i].size();
+    structure.resize(offsets.back());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        for (const ModelStart& model : buffers[i].models)
+            structure.models.push_back({model.atom + offsets[i], model.serial, 0});
+        structure.conect.insert(structure.conect.end(), buffers[i].conect.begin(), buffers[i].conect.end());
+        structure.secondary.insert(structure.secondary.end(), buffers[i].secondary.begin(), buffers[i].secondary.end());
+    }
+    pool.parallelFor(buffers.size(), [&](size_t i) {
+        structure.copyFrom(buffers[i], offsets[i]);
+        buffers[i] = Structure();
+    });
+    return structure.size() - before;
+}
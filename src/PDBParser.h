@@ -0,0 +1,28 @@
+#ifndef PDB_PARSER_H
+#define PDB_PARSER_H
+
+#include <string_view>
+#include <vector>
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Decodes every ATOM and HETATM record of a PDB file held in memory into the columns of
+// `structure`, CONECT records into structure.conect and HELIX and SHEET records into
+// structure.secondary. Fields are read in place from their fixed columns, so no
+// allocation happens per record. Returns the number of atoms appended.
+size_t parsePDBAtoms(std::string_view text, Structure& structure);
+
+// Same as parsePDBAtoms, but splits the text into newline-aligned chunks that are parsed
+// on `pool`, one atom buffer per chunk. Chunks are concatenated in file order, so the
+// resulting atom order is identical to the serial parser.
+size_t parsePDBAtomsParallel(std::string_view text, Structure& structure, ThreadPool& pool);
+
+// Splits text into about `pieces` chunks whose boundaries fall just after a newline, so
+// every record lies entirely inside one chunk
+std::vector<std::string_view> splitPDBText(std::string_view text, size_t pieces);
+
+// Decodes a fixed-width decimal field such as "  28.668" (PDB %8.3f columns).
+// Falls back to std::from_chars for anything the fast path does not handle.
+bool parseFixedFloat(std::string_view field, float& value);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free single-producer/single-consumer ring buffer. One slot is kept free to
+// tell "full" from "empty", so at most Capacity - 1 items are queued at once.
+template <typename T, size_t Capacity>
+class SPSCQueue
+{
+public:
+    // Producer side; returns false when the queue is full
+    bool push(T&& value) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % Capacity;
+        if (next == headIndex.load(std::memory_order_acquire))
+            return false;
+        slots[tail] = std::move(value);
+        tailIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; returns false when the queue is empty
+    bool pop(T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire))
+            return false;
+        value = std::move(slots[head]);
+        headIndex.store((head + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+    // Separate cache lines so producer and consumer do not false-share
+    alignas(64) std::atomic<size_t> headIndex{0};
+    alignas(64) std::atomic<size_t> tailIndex{0};
+};
+#endif
@@ -0,0 +1,257 @@
+#include "Sasa.h"
+#include "Elements.h"
+#include "SpatialIndex.h"
+#include "SpherePoints.h"
+#include "AtomOrder.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SASA_SSE 1
+#endif
+
+// Atoms per parallel task
+static const size_t atomBlockSize = 2048;
+
+static float probeSphereRadius(uint8_t element) {
+    return elementInfo(element).vdwRadius + probeRadius;
+}
+
+// Neighbors of one atom as padded structure-of-arrays, relative to the atom's center, so
+// a point is tested against four neighbors per step
+struct NeighborList {
+    std::vector<float> x, y, z, radiusSquared;
+    size_t count = 0;
+
+    void clear() { x.clear(); y.clear(); z.clear(); radiusSquared.clear(); count = 0; }
+    void add(const glm::vec3& offset, float radius) {
+        x.push_back(offset.x);
+        y.push_back(offset.y);
+        z.push_back(offset.z);
+        radiusSquared.push_back(radius * radius);
+        ++count;
+    }
+    // Padding entries have a negative radius, so no point is ever inside them
+    void pad() {
+        while (x.size() % 4 != 0) {
+            x.push_back(0.0f);
+            y.push_back(0.0f);
+            z.push_back(0.0f);
+            radiusSquared.push_back(-1.0f);
+        }
+    }
+};
+
+// Index of a group of four neighbors, one of which contains point p, or -1
+static int findOccluder(const NeighborList& neighbors, const glm::vec3& p, int firstGuess) {
+    size_t groups = neighbors.x.size() / 4;
+#ifdef SASA_SSE
+    const __m128 px = _mm_set1_ps(p.x);
+    const __m128 py = _mm_set1_ps(p.y);
+    const __m128 pz = _mm_set1_ps(p.z);
+    auto inside = [&](size_t g) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&neighbors.x[g * 4]), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&neighbors.y[g * 4]), py);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&neighbors.z[g * 4]), pz);
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        return _mm_movemask_ps(_mm_cmplt_ps(d2, _mm_loadu_ps(&neighbors.radiusSquared[g * 4]))) != 0;
+    };
+#else
+    auto inside = [&](size_t g) {
+        for (size_t k = g * 4; k < g * 4 + 4; ++k) {
+            float dx = neighbors.x[k] - p.x;
+            float dy = neighbors.y[k] - p.y;
+            float dz = neighbors.z[k] - p.z;
+            if (dx * dx + dy * dy + dz * dz < neighbors.radiusSquared[k])
+                return true;
+        }
+        return false;
+    };
+#endif
+    // Neighboring points are usually buried by the same atom: try last point's group first
+    if (firstGuess >= 0 && inside(firstGuess))
+        return firstGuess;
+    for (size_t g = 0; g < groups; ++g) {
+        if (static_cast<int>(g) != firstGuess && inside(g))
+            return static_cast<int>(g);
+    }
+    return -1;
+}
+
+// Neighbor spheres that overlap atom i's probe sphere, closest first (they hide the most
+// points), relative to its center
+static void gatherNeighbors(const Structure& structure, const SpatialIndex& index, size_t i, float maxRadius,
+                            std::vector<uint32_t>& candidates, std::vector<std::pair<float, uint32_t>>& byDistance,
+                            NeighborList& neighbors) {
+    glm::vec3 center = structure.position(i);
+    float radius = probeSphereRadius(structure.element[i]);
+    candidates.clear();
+    index.radiusQuery(center, radius + maxRadius, candidates);
+    byDistance.clear();
+    for (uint32_t j : candidates) {
+        if (j == i)
+            continue;
+        glm::vec3 d = index.position(j) - center;
+        float distanceSquared = glm::dot(d, d);
+        float reach = radius + probeSphereRadius(structure.element[j]);
+        if (distanceSquared < reach * reach)
+            byDistance.push_back({distanceSquared, j});
+    }
+    std::sort(byDistance.begin(), byDistance.end());
+    neighbors.clear();
+    for (const auto& [distanceSquared, j] : byDistance)
+        neighbors.add(index.position(j) - center, probeSphereRadius(structure.element[j]));
+    neighbors.pad();
+}
+
+// Calls visit(atom, point) for every accessible point of every atom, from parallel blocks.
+// pointsOf(atom) gives the unit sphere points to test.
+template <typename Points, typename Visit>
+static void forEachAccessiblePoint(const Structure& structure, ThreadPool& pool, Points&& pointsOf, Visit&& visit) {
+    size_t n = structure.size();
+    float maxRadius = 0.0f;
+    for (size_t i = 0; i < n; ++i)
+        maxRadius = std::max(maxRadius, probeSphereRadius(structure.element[i]));
+    SpatialIndex index;
+    index.build(structure, 2.0f * maxRadius, pool);
+
+    pool.parallelFor((n + atomBlockSize - 1) / atomBlockSize, [&](size_t b) {
+        std::vector<uint32_t> candidates;
+        NeighborList neighbors;
+        std::vector<std::pair<float, uint32_t>> byDistance;
+        for (size_t i = b * atomBlockSize; i < std::min(n, (b + 1) * atomBlockSize); ++i) {
+            gatherNeighbors(structure, index, i, maxRadius, candidates, byDistance, neighbors);
+            float radius = probeSphereRadius(structure.element[i]);
+            int lastOccluder = -1;
+            for (const glm::vec3& point : pointsOf(i)) {
+                int occluder = findOccluder(neighbors, point * radius, lastOccluder);
+                if (occluder < 0)
+                    visit(b, i, point * radius);
+                else
+                    lastOccluder = occluder;
+            }
+        }
+    });
+}
+
+void computeSASA(const Structure& structure, ThreadPool& pool, std::vector<float>& atomArea, int pointCount) {
+    size_t n = structure.size();
+    atomArea.assign(n, 0.0f);
+    if (n == 0 || pointCount <= 0)
+        return;
+
+    const std::vector<glm::vec3> points = spherePoints(pointCount);
+    std::vector<uint32_t> accessible(n, 0);
+    forEachAccessiblePoint(structure, pool, [&](size_t) -> const std::vector<glm::vec3>& { return points; },
+                           [&](size_t, size_t i, const glm::vec3&) { ++accessible[i]; });
+    for (size_t i = 0; i < n; ++i) {
+        float radius = probeSphereRadius(structure.element[i]);
+        atomArea[i] = 4.0f * 3.14159265f * radius * radius * accessible[i] / pointCount;
+    }
+}
+
+void accessibleProbeCenters(const Structure& structure, float spacing, ThreadPool& pool,
+                            std::vector<glm::vec3>& centers, std::vector<uint32_t>& atoms) {
+    centers.clear();
+    atoms.clear();
+    if (structure.empty())
+        return;
+
+    // One point set per element, about one point per spacing^2 of sphere area
+    std::array<std::vector<glm::vec3>, elementTable.size()> pointsByElement;
+    for (size_t i = 0; i < structure.size(); ++i) {
+        std::vector<glm::vec3>& points = pointsByElement[structure.element[i]];
+        if (points.empty()) {
+            float radius = probeSphereRadius(structure.element[i]);
+            float area = 4.0f * 3.14159265f * radius * radius;
+            points = spherePoints(std::clamp(static_cast<int>(area / (spacing * spacing)), 12, 2000));
+        }
+    }
+
+    size_t blocks = (structure.size() + atomBlockSize - 1) / atomBlockSize;
+    std::vector<std::vector<glm::vec3>> blockCenters(blocks);
+    std::vector<std::vector<uint32_t>> blockAtoms(blocks);
+    forEachAccessiblePoint(structure, pool,
+                           [&](size_t i) -> const std::vector<glm::vec3>& { return pointsByElement[structure.element[i]]; },
+                           [&](size_t b, size_t i, const glm::vec3& offset) {
+                               blockCenters[b].push_back(structure.position(i) + offset);
+                               blockAtoms[b].push_back(static_cast<uint32_t>(i));
+                           });
+    for (size_t b = 0; b < blocks; ++b) {
+        centers.insert(centers.end(), blockCenters[b].begin(), blockCenters[b].end());
+        atoms.insert(atoms.end(), blockAtoms[b].begin(), blockAtoms[b].end());
+    }
+}
+
+float relativeSASA(const Structure& structure, const std::vector<float>& atomArea, size_t atom) {
+    float radius = probeSphereRadius(structure.element[atom]);
+    return std::clamp(atomArea[atom] / (4.0f * 3.14159265f * radius * radius), 0.0f, 1.0f);
+}
+
+void residueSASA(const Structure& structure, const std::vector<float>& atomArea, std::vector<ResidueArea>& residues) {
+    residues.clear();
+    for (size_t i = 0; i < structure.size() && i < atomArea.size(); ++i) {
+        bool sameResidue = i > 0 && structure.sameResidue(i, i - 1);
+        if (sameResidue) {
+            ++residues.back().atomCount;
+            residues.back().area += atomArea[i];
+        } else {
+            residues.push_back({static_cast<uint32_t>(i), 1, atomArea[i]});
+        }
+    }
+}
+
+// Fixed-width field without its space padding
+template <size_t N>
+static std::string trimmed(const std::array<char, N>& field) {
+    std::string text(field.begin(), field.end());
+    size_t first = text.find_first_not_of(' ');
+    if (first == std::string::npos)
+        return "";
+    return text.substr(first, text.find_last_not_of(' ') - first + 1);
+}
+
+static std::string trimmed(char c) {
+    return c == ' ' ? "" : std::string(1, c);
+}
+
+bool writeAtomSASACsv(const std::string& path, const Structure& structure, const std::vector<float>& atomArea) {
+    std::ofstream out(path);
+    if (!out.is_open() || atomArea.size() != structure.size())
+        return false;
+    out << "serial,atom,residue,chain,residue_number,insertion_code,element,sasa\n";
+    // Atoms may have been reordered; rows follow the file
+    std::vector<uint32_t> order = fileOrderOf(structure);
+    for (uint32_t i : order) {
+        const char* symbol = elementInfo(structure.element[i]).symbol;
+        out << structure.serial[i] << ',' << trimmed(structure.atomName[i]) << ','
+            << trimmed(structure.residueName[i]) << ',' << trimmed(structure.chain[i]) << ','
+            << structure.residueNumber[i] << ',' << trimmed(structure.insertionCode[i]) << ','
+            << trimmed(std::array<char, 2>{symbol[0], symbol[1]}) << ',' << atomArea[i] << '\n';
+    }
+    return out.good();
+}
+
+bool writeResidueSASACsv(const std::string& path, const Structure& structure, const std::vector<float>& atomArea) {
+    std::ofstream out(path);
+    if (!out.is_open() || atomArea.size() != structure.size())
+        return false;
+    std::vector<ResidueArea> residues;
+    residueSASA(structure, atomArea, residues);
+    std::sort(residues.begin(), residues.end(), [&](const ResidueArea& a, const ResidueArea& b) {
+        return structure.fileIndex(a.firstAtom) < structure.fileIndex(b.firstAtom);
+    });
+    out << "chain,residue_number,insertion_code,residue,atoms,sasa\n";
+    for (const ResidueArea& residue : residues) {
+        uint32_t i = residue.firstAtom;
+        out << trimmed(structure.chain[i]) << ',' << structure.residueNumber[i] << ','
+            << trimmed(structure.insertionCode[i]) << ',' << trimmed(structure.residueName[i]) << ','
+            << residue.atomCount << ',' << residue.area << '\n';
+    }
+    return out.good();
+}
@@ -0,0 +1,47 @@
+#ifndef SASA_H
+#define SASA_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Radius of the water probe rolled over the van der Waals surface, in Angstroms
+constexpr float probeRadius = 1.4f;
+// Test points per atom sphere; 100 keeps per-atom errors within a few percent
+constexpr int sasaPointCount = 100;
+
+// Solvent-accessible surface area of every atom, in square Angstroms (Shrake-Rupley).
+// Each atom's sphere (van der Waals radius plus the probe) is sampled with a golden-spiral
+// point set; a point is accessible unless it lies inside a neighboring sphere. Neighbors
+// come from a SpatialIndex and are tested four at a time with SSE where available. Atoms
+// are processed in parallel blocks on `pool`.
+void computeSASA(const Structure& structure, ThreadPool& pool, std::vector<float>& atomArea,
+                 int pointCount = sasaPointCount);
+
+// Probe positions in contact with the atoms: the points of every atom's probe sphere that
+// lie outside all other probe spheres, about one per spacing^2 of sphere area, and the atom
+// each belongs to. The solvent-excluded surface is the boundary of the probe spheres at
+// these centers (see MolecularSurface.h).
+void accessibleProbeCenters(const Structure& structure, float spacing, ThreadPool& pool,
+                            std::vector<glm::vec3>& centers, std::vector<uint32_t>& atoms);
+
+// Fraction of an atom's probe sphere that is accessible, 0 (buried) to 1 (isolated)
+float relativeSASA(const Structure& structure, const std::vector<float>& atomArea, size_t atom);
+
+// Summed area of every residue, a run of consecutive atoms with the same chain, residue
+// number and insertion code
+struct ResidueArea {
+    uint32_t firstAtom;
+    uint32_t atomCount;
+    float area;
+};
+void residueSASA(const Structure& structure, const std::vector<float>& atomArea, std::vector<ResidueArea>& residues);
+
+// CSV export, rows in file order. Return false if the file could not be written.
+bool writeAtomSASACsv(const std::string& path, const Structure& structure, const std::vector<float>& atomArea);
+bool writeResidueSASACsv(const std::string& path, const Structure& structure, const std::vector<float>& atomArea);
+
+#endif
@@ -0,0 +1,251 @@
+#include "SecondaryStructure.h"
+#include "AtomOrder.h"
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+// Partial charges times the dimensional factor of DSSP, in kcal/mol * Angstrom
+const float couplingConstant = 0.084f * 332.0f;
+// Energies are clamped here, as atoms this close are overlapping rather than bonded
+const float minimumEnergy = -9.9f;
+// C(i-1)-N(i) distances above this are a chain break
+const float maxPeptideBond = 2.5f;
+
+const uint32_t noResidue = UINT32_MAX;
+
+// A residue with a complete backbone
+struct BackboneResidue {
+    glm::vec3 n, alpha, c, o, h;
+    uint32_t firstAtom;
+    // Run of peptide-bonded residues this one belongs to
+    uint32_t segment;
+    // Has an amide hydrogen: bonded to its predecessor, and not a proline
+    bool donor;
+};
+
+struct HydrogenBond {
+    uint32_t acceptor = noResidue;
+    float energy = 0.0f;
+};
+
+struct Bridge {
+    uint32_t i, j;
+    bool parallel;
+
+    bool operator<(const Bridge& other) const {
+        return std::tie(parallel, i, j) < std::tie(other.parallel, other.i, other.j);
+    }
+    bool operator==(const Bridge& other) const {
+        return i == other.i && j == other.j && parallel == other.parallel;
+    }
+};
+
+// DSSP energy of the bond from the N-H of `donor` to the C=O of `acceptor`
+float bondEnergy(const BackboneResidue& donor, const BackboneResidue& acceptor) {
+    float on = glm::length(acceptor.o - donor.n);
+    float ch = glm::length(acceptor.c - donor.h);
+    float oh = glm::length(acceptor.o - donor.h);
+    float cn = glm::length(acceptor.c - donor.n);
+    if (on < 0.5f || ch < 0.5f || oh < 0.5f || cn < 0.5f)
+        return minimumEnergy;
+    return std::max(minimumEnergy, couplingConstant * (1.0f / on + 1.0f / ch - 1.0f / oh - 1.0f / cn));
+}
+
+} // namespace
+
+void assignSecondaryStructure(const Structure& structure, ThreadPool& pool, std::vector<SecondaryRange>& ranges) {
+    ranges.clear();
+
+    // Complete backbones in file order. A missing atom or a long C-N distance starts a new segment.
+    std::vector<BackboneResidue> residues;
+    std::vector<uint32_t> order = fileOrderOf(structure);
+    uint32_t segments = 0;
+    bool linked = false;
+    size_t k = 0;
+    while (k < order.size()) {
+        size_t first = order[k];
+        uint32_t atoms[4] = {noResidue, noResidue, noResidue, noResidue};
+        const char* names[4] = {" N  ", " CA ", " C  ", " O  "};
+        for (; k < order.size(); ++k) {
+            size_t atom = order[k];
+            if (!structure.sameResidue(atom, first))
+                break;
+            for (int a = 0; a < 4; ++a) {
+                if (atoms[a] == noResidue && structure.isAtomNamed(atom, names[a]))
+                    atoms[a] = static_cast<uint32_t>(atom);
+            }
+        }
+        if (std::find(std::begin(atoms), std::end(atoms), noResidue) != std::end(atoms)) {
+            linked = false;
+            continue;
+        }
+        BackboneResidue residue;
+        residue.n = structure.position(atoms[0]);
+        residue.alpha = structure.position(atoms[1]);
+        residue.c = structure.position(atoms[2]);
+        residue.o = structure.position(atoms[3]);
+        residue.firstAtom = static_cast<uint32_t>(first);
+        const BackboneResidue* previous = linked ? &residues.back() : nullptr;
+        if (previous && (structure.chain[previous->firstAtom] != structure.chain[first] ||
+                         glm::length(residue.n - previous->c) > maxPeptideBond))
+            previous = nullptr;
+        residue.segment = previous ? previous->segment : segments++;
+        const ResidueName& name = structure.residueName[first];
+        residue.donor = previous && !(name[0] == 'P' && name[1] == 'R' && name[2] == 'O');
+        // The amide hydrogen, 1 Angstrom from N opposite the previous carbonyl
+        residue.h = previous ? residue.n + glm::normalize(previous->c - previous->o) : residue.n;
+        residues.push_back(residue);
+        linked = true;
+    }
+    const uint32_t count = static_cast<uint32_t>(residues.size());
+    if (count == 0)
+        return;
+
+    // The two strongest acceptors of every donor, found among residues with CA atoms in reach
+    std::vector<glm::vec3> alphas(count);
+    for (uint32_t r = 0; r < count; ++r)
+        alphas[r] = residues[r].alpha;
+    SpatialIndex index;
+    index.build(alphas, hydrogenBondAlphaDistance, pool);
+    std::vector<uint32_t> neighborOffsets, neighbors;
+    index.radiusQueries(alphas, hydrogenBondAlphaDistance, pool, neighborOffsets, neighbors);
+    std::vector<HydrogenBond> bonds(2 * static_cast<size_t>(count));
+    const size_t donorsPerTask = 1024;
+    pool.parallelFor((count + donorsPerTask - 1) / donorsPerTask, [&](size_t task) {
+        for (uint32_t d = task * donorsPerTask; d < std::min<size_t>(count, (task + 1) * donorsPerTask); ++d) {
+            if (!residues[d].donor)
+                continue;
+            HydrogenBond* best = &bonds[2 * static_cast<size_t>(d)];
+            for (uint32_t q = neighborOffsets[d]; q < neighborOffsets[d + 1]; ++q) {
+                uint32_t a = neighbors[q];
+                // A residue's own carbonyl, and that of the peptide it closes, are no partners
+                if (a == d || (a + 1 == d && residues[a].segment == residues[d].segment))
+                    continue;
+                float energy = bondEnergy(residues[d], residues[a]);
+                if (energy < best[0].energy) {
+                    best[1] = best[0];
+                    best[0] = {a, energy};
+                } else if (energy < best[1].energy) {
+                    best[1] = {a, energy};
+                }
+            }
+        }
+    });
+
+    // The DSSP Hbond(i, j): C=O of residue i bonded to N-H of residue j
+    auto bonded = [&](int64_t i, int64_t j) {
+        if (i < 0 || j < 0 || i >= count || j >= count)
+            return false;
+        const HydrogenBond* b = &bonds[2 * static_cast<size_t>(j)];
+        return (b[0].acceptor == i && b[0].energy < hydrogenBondEnergyCutoff) ||
+               (b[1].acceptor == i && b[1].energy < hydrogenBondEnergyCutoff);
+    };
+    // Residue i has peptide-bonded neighbors on both sides
+    auto inside = [&](uint32_t i) {
+        return i > 0 && i + 1 < count && residues[i - 1].segment == residues[i].segment &&
+               residues[i + 1].segment == residues[i].segment;
+    };
+
+    // Bridges: the first bond of every bridge pattern, Hbond(a, d), puts the pair at (a + 1, d)
+    // (parallel), (a, d) or (a + 1, d - 1) (antiparallel). Those candidates go in fixed slots
+    // per bond and are tested in parallel.
+    const int candidatesPerBond = 3;
+    std::vector<Bridge> candidates(2 * candidatesPerBond * static_cast<size_t>(count), {noResidue, noResidue, false});
+    pool.parallelFor((count + donorsPerTask - 1) / donorsPerTask, [&](size_t task) {
+        for (uint32_t d = task * donorsPerTask; d < std::min<size_t>(count, (task + 1) * donorsPerTask); ++d) {
+            for (int b = 0; b < 2; ++b) {
+                const HydrogenBond& bond = bonds[2 * static_cast<size_t>(d) + b];
+                if (bond.acceptor == noResidue || bond.energy >= hydrogenBondEnergyCutoff)
+                    continue;
+                uint32_t a = bond.acceptor;
+                uint32_t pairs[candidatesPerBond][2] = {{a + 1, d}, {a, d}, {a + 1, d - 1}};
+                for (int p = 0; p < candidatesPerBond; ++p) {
+                    uint32_t i = std::min(pairs[p][0], pairs[p][1]), j = std::max(pairs[p][0], pairs[p][1]);
+                    if (j >= count || !inside(i) || !inside(j))
+                        continue;
+                    // Residues of one segment need two residues between them
+                    if (residues[i].segment == residues[j].segment && j < i + 3)
+                        continue;
+                    Bridge& slot = candidates[(2 * static_cast<size_t>(d) + b) * candidatesPerBond + p];
+                    if ((bonded(i - 1, j) && bonded(j, i + 1)) || (bonded(j - 1, i) && bonded(i, j + 1)))
+                        slot = {i, j, true};
+                    else if ((bonded(i, j) && bonded(j, i)) || (bonded(i - 1, j + 1) && bonded(j - 1, i + 1)))
+                        slot = {i, j, false};
+                }
+            }
+        }
+    });
+    std::vector<Bridge> bridges;
+    for (const Bridge& bridge : candidates) {
+        if (bridge.i != noResidue)
+            bridges.push_back(bridge);
+    }
+    std::sort(bridges.begin(), bridges.end());
+    bridges.erase(std::unique(bridges.begin(), bridges.end()), bridges.end());
+
+    // Bridges with a neighbor bridge along the same ladder are strand residues
+    std::vector<uint8_t> strand(count, 0);
+    auto hasBridge = [&](uint32_t i, uint32_t j, bool parallel) {
+        return std::binary_search(bridges.begin(), bridges.end(), Bridge{i, j, parallel});
+    };
+    for (const Bridge& bridge : bridges) {
+        uint32_t i = bridge.i, j = bridge.j;
+        bool ladder = bridge.parallel ? hasBridge(i + 1, j + 1, true) || hasBridge(i - 1, j - 1, true)
+                                      : hasBridge(i + 1, j - 1, false) || hasBridge(i - 1, j + 1, false);
+        if (ladder)
+            strand[i] = strand[j] = 1;
+    }
+
+    // Segments run one after another in residue order
+    std::vector<uint32_t> segmentStart(segments + 1, count);
+    for (uint32_t r = count; r-- > 0;)
+        segmentStart[residues[r].segment] = r;
+
+    // Helices and strands, one segment at a time. Turns and helices never leave a segment.
+    std::vector<uint8_t> type(count, SecondaryCoil);
+    pool.parallelFor(segments, [&](size_t s) {
+        uint32_t first = segmentStart[s], end = segmentStart[s + 1];
+        // An n-turn at i is the bond Hbond(i, i + n); turns at i - 1 and i make residues
+        // i .. i + n - 1 helical
+        auto markHelices = [&](uint32_t n, bool onlyCoil) {
+            for (uint32_t i = first + 1; i + n < end; ++i) {
+                if (!bonded(i - 1, i - 1 + n) || !bonded(i, i + n))
+                    continue;
+                bool unclaimed = true;
+                for (uint32_t r = i; onlyCoil && r < i + n; ++r)
+                    unclaimed &= type[r] == SecondaryCoil;
+                for (uint32_t r = i; unclaimed && r < i + n; ++r)
+                    type[r] = SecondaryHelix;
+            }
+        };
+        // Alpha helices first, then strands, then 3-10 and pi helices where nothing else is
+        markHelices(4, false);
+        for (uint32_t r = first; r < end; ++r) {
+            if (strand[r] && type[r] == SecondaryCoil)
+                type[r] = SecondaryStrand;
+        }
+        markHelices(3, true);
+        markHelices(5, true);
+    });
+
+    // One record per run
+    for (uint32_t r = 0; r < count;) {
+        uint32_t end = r + 1;
+        while (end < count && type[end] == type[r] && residues[end].segment == residues[r].segment)
+            ++end;
+        if (type[r] != SecondaryCoil) {
+            uint32_t firstAtom = residues[r].firstAtom, lastAtom = residues[end - 1].firstAtom;
+            SecondaryRange range{};
+            range.chain = structure.chain[firstAtom];
+            range.firstResidue = structure.residueNumber[firstAtom];
+            range.lastResidue = structure.residueNumber[lastAtom];
+            range.firstInsertion = structure.insertionCode[firstAtom];
+            range.lastInsertion = structure.insertionCode[lastAtom];
+            range.type = type[r];
+            ranges.push_back(range);
+        }
+        r = end;
+    }
+}
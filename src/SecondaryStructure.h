@@ -0,0 +1,27 @@
+#ifndef SECONDARY_STRUCTURE_H
+#define SECONDARY_STRUCTURE_H
+
+#include <vector>
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Backbone hydrogen bonds with an electrostatic energy below this count (kcal/mol, DSSP)
+constexpr float hydrogenBondEnergyCutoff = -0.5f;
+// Residues whose CA atoms are further apart than this never share a hydrogen bond
+constexpr float hydrogenBondAlphaDistance = 9.0f;
+
+// Secondary structure from the backbone geometry, following DSSP (Kabsch & Sander 1983).
+// Residues with N, CA, C and O atoms get an amide hydrogen placed along the bisector of
+// the previous peptide, and every N-H...O=C pair gets the DSSP electrostatic energy; each
+// donor keeps its two strongest acceptors. Candidate acceptors come from a SpatialIndex
+// over the CA atoms instead of all pairs, and donors are evaluated in parallel blocks on
+// `pool`. From the bonds:
+//   - two consecutive n-turns (3, 4 or 5) make a helix, alpha helices taking precedence
+//     over 3-10 and pi helices, which are all reported as SecondaryHelix;
+//   - parallel and antiparallel bridges that form a ladder of two or more make a strand.
+//     Isolated bridges and beta bulges are left as coil.
+// Patterns are marked chain by chain in parallel. Replaces `ranges` with one record per
+// run of helix or strand residues, in file order, in the form of structure.secondary.
+void assignSecondaryStructure(const Structure& structure, ThreadPool& pool, std::vector<SecondaryRange>& ranges);
+
+#endif
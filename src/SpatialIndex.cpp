@@ -0,0 +1,231 @@
+#include "SpatialIndex.h"
+#include <atomic>
+#include <limits>
+#include <queue>
+
+void SpatialIndex::clear() {
+    cellStart.clear();
+    slotAtoms.clear();
+    slotPositions.clear();
+    atomSlot.clear();
+    atomCell.clear();
+}
+
+void SpatialIndex::build(const Structure& structure, float cellSize, ThreadPool& pool) {
+    buildFrom(structure.size(), [&](size_t i) { return structure.position(i); }, cellSize, pool);
+}
+
+void SpatialIndex::build(const std::vector<SphereInstance>& instances, float cellSize, ThreadPool& pool) {
+    buildFrom(instances.size(), [&](size_t i) { return instances[i].position; }, cellSize, pool);
+}
+
+void SpatialIndex::build(const std::vector<glm::vec3>& points, float cellSize, ThreadPool& pool) {
+    buildFrom(points.size(), [&](size_t i) { return points[i]; }, cellSize, pool);
+}
+
+void SpatialIndex::update(const Structure& structure, ThreadPool& pool) {
+    updateFrom(structure.size(), [&](size_t i) { return structure.position(i); }, pool);
+}
+
+void SpatialIndex::update(const std::vector<SphereInstance>& instances, ThreadPool& pool) {
+    updateFrom(instances.size(), [&](size_t i) { return instances[i].position; }, pool);
+}
+
+void SpatialIndex::update(const std::vector<glm::vec3>& points, ThreadPool& pool) {
+    updateFrom(points.size(), [&](size_t i) { return points[i]; }, pool);
+}
+
+template <typename Positions>
+void SpatialIndex::buildFrom(size_t n, Positions&& positionOf, float cellSize, ThreadPool& pool) {
+    clear();
+    float inf = std::numeric_limits<float>::infinity();
+    glm::vec3 low(inf), high(-inf);
+    for (size_t i = 0; i < n; ++i) {
+        low = glm::min(low, positionOf(i));
+        high = glm::max(high, positionOf(i));
+    }
+    glm::vec3 extent = n > 0 ? high - low : glm::vec3(0.0f);
+
+    origin = n > 0 ? low : glm::vec3(0.0f);
+    cell = std::max(cellSize, 1e-3f);
+    size_t budget = cellsPerAtom * n + 64;
+    for (;;) {
+        size_t cells = 1;
+        for (int axis = 0; axis < 3; ++axis) {
+            dims[axis] = static_cast<int>(extent[axis] / cell) + 1;
+            cells *= dims[axis];
+        }
+        if (cells <= budget)
+            break;
+        cell *= 1.25f;
+    }
+    inverseCell = 1.0f / cell;
+    sortIntoCells(n, positionOf, pool);
+}
+
+// Counting sort of the atoms by cell, reusing the existing storage
+template <typename Positions>
+void SpatialIndex::sortIntoCells(size_t n, Positions&& positionOf, ThreadPool& pool) {
+    atomCell.resize(n);
+    size_t blocks = (n + slotBlockSize - 1) / slotBlockSize;
+    pool.parallelFor(blocks, [&](size_t b) {
+        for (size_t i = b * slotBlockSize; i < std::min(n, (b + 1) * slotBlockSize); ++i) {
+            glm::ivec3 c = cellOfPoint(positionOf(i));
+            atomCell[i] = static_cast<uint32_t>(cellIndex(c.x, c.y, c.z));
+        }
+    });
+
+    size_t cells = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
+    cellStart.assign(cells + 1, 0);
+    for (size_t i = 0; i < n; ++i)
+        ++cellStart[atomCell[i] + 1];
+    for (size_t c = 0; c < cells; ++c)
+        cellStart[c + 1] += cellStart[c];
+    std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+    slotAtoms.resize(n);
+    slotPositions.resize(n);
+    atomSlot.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t slot = cursor[atomCell[i]]++;
+        slotAtoms[slot] = static_cast<uint32_t>(i);
+        slotPositions[slot] = positionOf(i);
+        atomSlot[i] = slot;
+    }
+}
+
+template <typename Positions>
+void SpatialIndex::updateFrom(size_t n, Positions&& positionOf, ThreadPool& pool) {
+    if (n != slotAtoms.size() || cellStart.empty()) {
+        buildFrom(n, positionOf, cell, pool);
+        return;
+    }
+    // Most frames move atoms by less than a cell; then the order stays and only the
+    // copied positions change
+    std::atomic<bool> moved{false};
+    size_t blocks = (n + slotBlockSize - 1) / slotBlockSize;
+    pool.parallelFor(blocks, [&](size_t b) {
+        bool blockMoved = false;
+        for (size_t i = b * slotBlockSize; i < std::min(n, (b + 1) * slotBlockSize); ++i) {
+            glm::vec3 p = positionOf(i);
+            glm::ivec3 c = cellOfPoint(p);
+            blockMoved |= cellIndex(c.x, c.y, c.z) != atomCell[i];
+            slotPositions[atomSlot[i]] = p;
+        }
+        if (blockMoved)
+            moved.store(true, std::memory_order_relaxed);
+    });
+    if (moved.load())
+        sortIntoCells(n, positionOf, pool);
+}
+
+void SpatialIndex::radiusQuery(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const {
+    if (slotAtoms.empty())
+        return;
+    int reach = std::max(1, static_cast<int>(std::ceil(radius * inverseCell)));
+    float radiusSquared = radius * radius;
+    forEachRun(cellOfPoint(center), reach, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            glm::vec3 d = slotPositions[t] - center;
+            if (glm::dot(d, d) < radiusSquared)
+                result.push_back(slotAtoms[t]);
+        }
+    });
+}
+
+void SpatialIndex::radiusQueries(const std::vector<glm::vec3>& centers, float radius, ThreadPool& pool,
+                                 std::vector<uint32_t>& offsets, std::vector<uint32_t>& atoms) const {
+    // Each task answers a block of centers into its own list; the lists are then joined
+    const size_t centersPerTask = 1024;
+    size_t tasks = (centers.size() + centersPerTask - 1) / centersPerTask;
+    std::vector<std::vector<uint32_t>> found(tasks);
+    offsets.assign(centers.size() + 1, 0);
+    pool.parallelFor(tasks, [&](size_t task) {
+        for (size_t q = task * centersPerTask; q < std::min(centers.size(), (task + 1) * centersPerTask); ++q) {
+            radiusQuery(centers[q], radius, found[task]);
+            offsets[q + 1] = static_cast<uint32_t>(found[task].size());
+        }
+    });
+    // Per-task counts become global offsets
+    atoms.clear();
+    for (size_t task = 0; task < tasks; ++task) {
+        uint32_t base = static_cast<uint32_t>(atoms.size());
+        for (size_t q = task * centersPerTask; q < std::min(centers.size(), (task + 1) * centersPerTask); ++q)
+            offsets[q + 1] += base;
+        atoms.insert(atoms.end(), found[task].begin(), found[task].end());
+    }
+}
+
+void SpatialIndex::nearest(const glm::vec3& center, size_t k, std::vector<uint32_t>& result) const {
+    result.clear();
+    if (slotAtoms.empty() || k == 0)
+        return;
+    // Max-heap of the best k so far; cells are searched in growing shells around the
+    // center's cell, and shell r + 1 is no closer than r cells
+    std::priority_queue<std::pair<float, uint32_t>> best;
+    glm::ivec3 c = cellOfPoint(center);
+    int maxReach = std::max({dims[0], dims[1], dims[2]});
+    for (int reach = 0; reach <= maxReach; ++reach) {
+        for (int z = c.z - reach; z <= c.z + reach; ++z) {
+            if (z < 0 || z >= dims[2])
+                continue;
+            for (int y = c.y - reach; y <= c.y + reach; ++y) {
+                if (y < 0 || y >= dims[1])
+                    continue;
+                bool faceRow = std::abs(z - c.z) == reach || std::abs(y - c.y) == reach;
+                int step = faceRow || reach == 0 ? 1 : 2 * reach;
+                for (int x = c.x - reach; x <= c.x + reach; x += step) {
+                    if (x < 0 || x >= dims[0])
+                        continue;
+                    size_t index = cellIndex(x, y, z);
+                    for (uint32_t t = cellStart[index]; t < cellStart[index + 1]; ++t) {
+                        glm::vec3 d = slotPositions[t] - center;
+                        float distanceSquared = glm::dot(d, d);
+                        if (best.size() < k) {
+                            best.push({distanceSquared, slotAtoms[t]});
+                        } else if (distanceSquared < best.top().first) {
+                            best.pop();
+                            best.push({distanceSquared, slotAtoms[t]});
+                        }
+                    }
+                }
+            }
+        }
+        float shell = reach * cell;
+        if (best.size() == k && best.top().first <= shell * shell)
+            break;
+    }
+    result.resize(best.size());
+    for (size_t i = result.size(); i-- > 0;) {
+        result[i] = best.top().second;
+        best.pop();
+    }
+}
+
+int64_t SpatialIndex::nearestWithin(const glm::vec3& center, float maxDistance) const {
+    int64_t found = -1;
+    if (slotAtoms.empty())
+        return found;
+    int reach = std::max(1, static_cast<int>(std::ceil(maxDistance * inverseCell)));
+    float bestSquared = maxDistance * maxDistance;
+    forEachRun(cellOfPoint(center), reach, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            glm::vec3 d = slotPositions[t] - center;
+            float distanceSquared = glm::dot(d, d);
+            if (distanceSquared < bestSquared) {
+                bestSquared = distanceSquared;
+                found = slotAtoms[t];
+            }
+        }
+    });
+    return found;
+}
+
+void SpatialIndex::pairs(float radius, ThreadPool& pool, std::vector<Pair>& result) const {
+    std::vector<std::vector<Pair>> found(pairTaskCount());
+    forEachPair(radius, pool, [&](size_t task, uint32_t i, uint32_t j, float) {
+        found[task].push_back({std::min(i, j), std::max(i, j)});
+    });
+    result.clear();
+    for (const std::vector<Pair>& list : found)
+        result.insert(result.end(), list.begin(), list.end());
+}
@@ -0,0 +1,141 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Structure.h"
+#include "Sphere.h"
+#include "ThreadPool.h"
+
+// Cell list over atom positions for neighbor queries (bonds, contacts, SASA, picking,
+// selection by distance). Atoms are binned into a uniform grid of cubic cells and stored
+// sorted by cell, with their positions copied alongside, so a query scans a few short
+// contiguous runs. Queries are const and keep no state: any number of threads may query
+// at once, as long as nobody calls build() or update() meanwhile.
+//
+// Queries of any radius are exact; they are fastest when the radius is at most the cell
+// size, which build() takes as a parameter. Atoms outside the grid built over (e.g. after
+// update() moved them) are clamped into the border cells, which keeps results exact.
+class SpatialIndex
+{
+public:
+    using Pair = std::pair<uint32_t, uint32_t>;
+
+    void clear();
+    // Bins every atom of `structure` / every instance / every point
+    void build(const Structure& structure, float cellSize, ThreadPool& pool);
+    void build(const std::vector<SphereInstance>& instances, float cellSize, ThreadPool& pool);
+    void build(const std::vector<glm::vec3>& points, float cellSize, ThreadPool& pool);
+    // Re-bins after the atoms moved (e.g. a new trajectory frame), keeping the grid. Only
+    // positions are rewritten when no atom changed cell. A different atom count rebuilds.
+    void update(const Structure& structure, ThreadPool& pool);
+    void update(const std::vector<SphereInstance>& instances, ThreadPool& pool);
+    void update(const std::vector<glm::vec3>& points, ThreadPool& pool);
+
+    // Atoms within `radius` of `center`, appended to `result` in no particular order
+    void radiusQuery(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const;
+    // One radius query per center, run in parallel. Results come back in compressed sparse
+    // rows: the atoms near centers[q] are atoms[offsets[q], offsets[q + 1]).
+    void radiusQueries(const std::vector<glm::vec3>& centers, float radius, ThreadPool& pool,
+                       std::vector<uint32_t>& offsets, std::vector<uint32_t>& atoms) const;
+    // The k atoms nearest to `center`, closest first (fewer if the index holds fewer)
+    void nearest(const glm::vec3& center, size_t k, std::vector<uint32_t>& result) const;
+    // Nearest atom within maxDistance, or -1
+    int64_t nearestWithin(const glm::vec3& center, float maxDistance) const;
+
+    // Calls visit(task, i, j, distanceSquared) once for every pair of atoms closer than
+    // `radius`, from pairTaskCount() parallel tasks. `task` lets the caller keep per-task
+    // output without locking; concatenated in task order the pairs are deterministic.
+    template <typename F>
+    void forEachPair(float radius, ThreadPool& pool, F&& visit) const;
+    size_t pairTaskCount() const { return (slotAtoms.size() + slotBlockSize - 1) / slotBlockSize; }
+    // Every pair closer than `radius`, as (lower, higher) atom index
+    void pairs(float radius, ThreadPool& pool, std::vector<Pair>& result) const;
+
+    size_t size() const { return slotAtoms.size(); }
+    bool empty() const { return slotAtoms.empty(); }
+    float cellSize() const { return cell; }
+    size_t cellCount() const { return cellStart.empty() ? 0 : cellStart.size() - 1; }
+    const glm::vec3& position(uint32_t atom) const { return slotPositions[atomSlot[atom]]; }
+
+    // Slots per parallel task
+    static constexpr size_t slotBlockSize = 8192;
+    // Grid cells allowed per atom; sparse inputs get wider cells instead of a huge grid
+    static constexpr size_t cellsPerAtom = 4;
+
+private:
+    template <typename Positions>
+    void buildFrom(size_t n, Positions&& positionOf, float cellSize, ThreadPool& pool);
+    template <typename Positions>
+    void updateFrom(size_t n, Positions&& positionOf, ThreadPool& pool);
+    template <typename Positions>
+    void sortIntoCells(size_t n, Positions&& positionOf, ThreadPool& pool);
+
+    int cellCoordinate(float value, int axis) const {
+        return std::clamp(static_cast<int>(std::floor((value - origin[axis]) * inverseCell)), 0, dims[axis] - 1);
+    }
+    glm::ivec3 cellOfPoint(const glm::vec3& p) const {
+        return glm::ivec3(cellCoordinate(p.x, 0), cellCoordinate(p.y, 1), cellCoordinate(p.z, 2));
+    }
+    size_t cellIndex(int x, int y, int z) const {
+        return (static_cast<size_t>(z) * dims[1] + y) * dims[0] + x;
+    }
+    // Calls scan(firstSlot, endSlot) for every run of cells within `reach` cells of `c`
+    template <typename F>
+    void forEachRun(const glm::ivec3& c, int reach, F&& scan) const;
+
+    glm::vec3 origin{0.0f};
+    float cell = 1.0f;
+    float inverseCell = 1.0f;
+    int dims[3] = {1, 1, 1};
+    // Atoms sorted by cell: cell c holds slots [cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> cellStart;
+    std::vector<uint32_t> slotAtoms;
+    std::vector<glm::vec3> slotPositions;
+    // Inverse of slotAtoms, and the cell of every atom at the last build/update
+    std::vector<uint32_t> atomSlot;
+    std::vector<uint32_t> atomCell;
+};
+
+template <typename F>
+void SpatialIndex::forEachRun(const glm::ivec3& c, int reach, F&& scan) const {
+    int x0 = std::max(c.x - reach, 0);
+    int x1 = std::min(c.x + reach, dims[0] - 1);
+    for (int z = std::max(c.z - reach, 0); z <= std::min(c.z + reach, dims[2] - 1); ++z) {
+        for (int y = std::max(c.y - reach, 0); y <= std::min(c.y + reach, dims[1] - 1); ++y) {
+            // Cells along x are adjacent in memory: scan them as one run
+            scan(cellStart[cellIndex(x0, y, z)], cellStart[cellIndex(x1, y, z) + 1]);
+        }
+    }
+}
+
+template <typename F>
+void SpatialIndex::forEachPair(float radius, ThreadPool& pool, F&& visit) const {
+    if (slotAtoms.empty())
+        return;
+    int reach = std::max(1, static_cast<int>(std::ceil(radius * inverseCell)));
+    float radiusSquared = radius * radius;
+    size_t slots = slotAtoms.size();
+    pool.parallelFor(pairTaskCount(), [&](size_t task) {
+        size_t end = std::min(slots, (task + 1) * slotBlockSize);
+        for (size_t s = task * slotBlockSize; s < end; ++s) {
+            const glm::vec3 p = slotPositions[s];
+            // Every pair is seen from both slots; only the lower one reports it
+            forEachRun(cellOfPoint(p), reach, [&](size_t first, size_t last) {
+                for (size_t t = std::max(first, s + 1); t < last; ++t) {
+                    glm::vec3 d = slotPositions[t] - p;
+                    float distanceSquared = glm::dot(d, d);
+                    if (distanceSquared < radiusSquared)
+                        visit(task, slotAtoms[s], slotAtoms[t], distanceSquared);
+                }
+            });
+        }
+    });
+}
+
+#endif
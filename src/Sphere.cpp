@@ -16,19 +16,9 @@
 #include <vector>
 #include <unordered_map>
 #include "Sphere.h"
+#include "InstanceBuffer.h"
 #include <cmath>
 
-// ---- Atom Static Methods ----
-float Atom::getAtomicRadius(const std::string& element, const std::unordered_map<std::string, float>& vanDerWaalsRadii) {
-    auto it = vanDerWaalsRadii.find(element);
-    return (it != vanDerWaalsRadii.end()) ? it->second * 0.6f : 1.5f * 0.6f;
-}
-
-glm::vec3 Atom::getAtomColor(const std::string& element, const std::unordered_map<std::string, glm::vec3>& atomColors) {
-    auto it = atomColors.find(element);
-    return (it != atomColors.end()) ? it->second : glm::vec3(1.0f);
-}
-
 // ---- Sphere ----
 Sphere::Sphere(unsigned int sectorCount, unsigned int stackCount) {
     generateMesh(sectorCount, stackCount);
@@ -39,7 +29,6 @@ Sphere::~Sphere() {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteBuffers(1, &instanceVBO);
 }
 
 // Thank you to © 2005-2025, Song Ho Ahn (안성호) for providing the math behind the sphere mesh
@@ -128,47 +117,32 @@ void Sphere::draw() {
     glBindVertexArray(0);
 }
 
-void Sphere::drawInstances(const std::vector<SphereInstance>& instances) {
-    if (!instanceBufferInitialized) {
-        glGenBuffers(1, &instanceVBO);
-        instanceBufferInitialized = true;
-    }
+void Sphere::drawInstances(const InstanceBuffer& instanceBuffer) {
+    if (instanceBuffer.size() == 0)
+        return;
 
     glBindVertexArray(VAO);
 
-    // Format: vec3 pos, float scale, vec3 color → total = 7 floats
-    std::vector<float> instanceData;
-    for (const auto& inst : instances) {
-        instanceData.push_back(inst.position.x);
-        instanceData.push_back(inst.position.y);
-        instanceData.push_back(inst.position.z);
-        instanceData.push_back(inst.radius);
-        instanceData.push_back(inst.color.r);
-        instanceData.push_back(inst.color.g);
-        instanceData.push_back(inst.color.b);
+    // Instance data lives on the GPU already; only re-point attributes 3-5 when the
+    // instance buffer was reallocated
+    if (boundInstanceGeneration != instanceBuffer.generation()) {
+        instanceBuffer.bindAttributes();
+        boundInstanceGeneration = instanceBuffer.generation();
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(float), instanceData.data(), GL_DYNAMIC_DRAW);
-
-    // Position (vec3)
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(3);
-    glVertexAttribDivisor(3, 1);
-
-    // Radius (float)
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(4);
-    glVertexAttribDivisor(4, 1);
-
-    // Color (vec3)
-    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(4 * sizeof(float)));
-    glEnableVertexAttribArray(5);
-    glVertexAttribDivisor(5, 1);
-
     // Draw
-    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instances.size());
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instanceBuffer.size());
 
     glBindVertexArray(0);
 }
 
+void Sphere::drawInstances(const InstanceBuffer& instanceBuffer, const std::vector<InstanceRange>& ranges) {
+    glBindVertexArray(VAO);
+    for (const InstanceRange& range : ranges) {
+        instanceBuffer.bindAttributes(range.first);
+        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, range.count);
+    }
+    // Attributes no longer point at the start of the buffer
+    boundInstanceGeneration = 0;
+    glBindVertexArray(0);
+}
@@ -10,28 +10,23 @@
 #include <vector>
 #include <cmath>
 #include <string>
-#include <unordered_map>
-
-struct Atom {
-    std::string element;
-    glm::vec3 position;
-
-    Atom(const std::string& element, const glm::vec3& position)
-        : element(element), position(position) {}
-
-    float getAtomicRadius(const std::string& element, const std::unordered_map<std::string, float>& vanDerWaalsRadii);
-    glm::vec3 getAtomColor(const std::string& element, const std::unordered_map<std::string, glm::vec3>& atomColors);
-};
+#include <cstdint>
 
 struct SphereInstance {
     glm::vec3 position;
     float radius;
-    glm::vec3 color;
+    // Entry in the GPU color palette (see InstanceBuffer::setPalette)
+    uint8_t colorIndex;
+    // Ambient light reaching the atom, 0 (buried) to 255 (exposed), see AmbientOcclusion.h
+    uint8_t ambient = 255;
 
-    SphereInstance(const glm::vec3& position, float radius, const glm::vec3& color)
-        : position(position), radius(radius), color(color) {}
+    SphereInstance(const glm::vec3& position, float radius, uint8_t colorIndex)
+        : position(position), radius(radius), colorIndex(colorIndex) {}
 };
 
+class InstanceBuffer;
+struct InstanceRange;
+
 struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
@@ -44,7 +39,12 @@ public:
     ~Sphere();
 
     void draw();
-    void drawInstances(const std::vector<SphereInstance>& instances);
+    void drawInstances(const InstanceBuffer& instanceBuffer);
+    // Draws only the given instance ranges, one instanced call per range
+    void drawInstances(const InstanceBuffer& instanceBuffer, const std::vector<InstanceRange>& ranges);
+
+    size_t triangleCount() const { return indices.size() / 3; }
+    size_t vertexCount() const { return vertices.size(); }
 
 private:
     void generateMesh(unsigned int sectorCount, unsigned int stackCount);
@@ -55,9 +55,8 @@ private:
 
     GLuint VAO, VBO, EBO;
 
-    // For instancing
-    GLuint instanceVBO;
-    bool instanceBufferInitialized = false;
+    // For instancing: generation of the instance buffer whose attributes are bound to VAO
+    unsigned int boundInstanceGeneration = 0;
 };
 
 #endif
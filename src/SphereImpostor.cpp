@@ -0,0 +1,59 @@
+#include "SphereImpostor.h"
+#include "InstanceBuffer.h"
+
+// ---- SphereImpostor ----
+SphereImpostor::SphereImpostor() {
+    // Unit quad as a triangle strip; the vertex shader sizes it to cover the sphere
+    const float corners[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f,
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+    // corner
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+SphereImpostor::~SphereImpostor() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+}
+
+void SphereImpostor::drawInstances(const InstanceBuffer& instanceBuffer) {
+    if (instanceBuffer.size() == 0)
+        return;
+
+    glBindVertexArray(VAO);
+
+    // Same instance attributes 3-5 as the mesh path
+    if (boundInstanceGeneration != instanceBuffer.generation()) {
+        instanceBuffer.bindAttributes();
+        boundInstanceGeneration = instanceBuffer.generation();
+    }
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceBuffer.size());
+
+    glBindVertexArray(0);
+}
+
+void SphereImpostor::drawInstances(const InstanceBuffer& instanceBuffer, const std::vector<InstanceRange>& ranges) {
+    glBindVertexArray(VAO);
+    for (const InstanceRange& range : ranges) {
+        instanceBuffer.bindAttributes(range.first);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, range.count);
+    }
+    // Attributes no longer point at the start of the buffer
+    boundInstanceGeneration = 0;
+    glBindVertexArray(0);
+}
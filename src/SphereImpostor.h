@@ -0,0 +1,35 @@
+#ifndef SPHERE_IMPOSTOR_H
+#define SPHERE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <vector>
+
+class InstanceBuffer;
+struct InstanceRange;
+
+// Draws every sphere instance as a single camera-facing quad. The fragment shader
+// (atomImpostorFragment.glsl) intersects the view ray with the sphere, discards pixels
+// outside it and writes the exact normal and depth, so spheres are perfectly round at any
+// zoom for 2 triangles each instead of the ~1,900 of the tessellated Sphere mesh.
+class SphereImpostor {
+public:
+    SphereImpostor();
+    ~SphereImpostor();
+
+    SphereImpostor(const SphereImpostor&) = delete;
+    SphereImpostor& operator=(const SphereImpostor&) = delete;
+
+    void drawInstances(const InstanceBuffer& instanceBuffer);
+    // Draws only the given instance ranges, one instanced call per range
+    void drawInstances(const InstanceBuffer& instanceBuffer, const std::vector<InstanceRange>& ranges);
+
+    static constexpr unsigned int trianglesPerInstance = 2;
+
+private:
+    GLuint VAO, VBO;
+
+    // Generation of the instance buffer whose attributes are bound to VAO
+    unsigned int boundInstanceGeneration = 0;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "SphereLOD.h"
+#include "InstanceBuffer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Smallest projected radius, in pixels, at which each level is used
+static const float levelMinPixels[SphereLOD::levelCount] = {0.0f, 2.0f, 6.0f, 16.0f};
+// Atoms per binning task
+static const size_t binBlockSize = 1u << 16;
+
+// ---- SphereLOD ----
+SphereLOD::SphereLOD() {
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &idVBO);
+    generateMeshes();
+}
+
+SphereLOD::~SphereLOD() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &idVBO);
+}
+
+// Icosahedron, then each level splits every triangle into four and pushes the new
+// vertices out to the unit sphere. All levels share one vertex and one index buffer.
+void SphereLOD::generateMeshes() {
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    std::vector<glm::vec3> vertices = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1},
+    };
+    for (glm::vec3& v : vertices)
+        v = glm::normalize(v);
+    std::vector<unsigned int> faces = {
+        0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+        1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+        3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+        4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1,
+    };
+
+    std::vector<unsigned int> indices;
+    std::unordered_map<uint64_t, unsigned int> midpoints;
+    auto midpoint = [&](unsigned int a, unsigned int b) {
+        uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+        auto it = midpoints.find(key);
+        if (it != midpoints.end())
+            return it->second;
+        vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+        unsigned int index = static_cast<unsigned int>(vertices.size() - 1);
+        midpoints.emplace(key, index);
+        return index;
+    };
+
+    for (int level = 0; level < levelCount; ++level) {
+        if (level > 0) {
+            std::vector<unsigned int> finer;
+            finer.reserve(faces.size() * 4);
+            for (size_t f = 0; f < faces.size(); f += 3) {
+                unsigned int a = faces[f], b = faces[f + 1], c = faces[f + 2];
+                unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+                finer.insert(finer.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+            }
+            faces.swap(finer);
+        }
+        levels[level] = {indices.size(), faces.size()};
+        indices.insert(indices.end(), faces.begin(), faces.end());
+    }
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // position (doubles as the normal on a unit sphere)
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // instance id; re-pointed per level in drawInstances()
+    glBindBuffer(GL_ARRAY_BUFFER, idVBO);
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t SphereLOD::trianglesLastFrame() const {
+    size_t triangles = 0;
+    for (int level = 0; level < levelCount; ++level)
+        triangles += levelInstances[level] * triangleCount(level);
+    return triangles;
+}
+
+void SphereLOD::drawInstances(const InstanceBuffer& instanceBuffer, const std::vector<SphereInstance>& instances,
+                              const std::vector<InstanceRange>& ranges, const glm::mat4& view,
+                              const glm::mat4& projection, float viewportHeight) {
+    levelInstances.fill(0);
+    idBytes = 0;
+    size_t n = std::min(instances.size(), instanceBuffer.size());
+    if (n == 0)
+        return;
+
+    // Split the ranges into binning tasks of at most binBlockSize atoms
+    std::vector<InstanceRange> tasks;
+    for (const InstanceRange& range : ranges) {
+        size_t end = std::min<size_t>(n, range.first + range.count);
+        for (size_t first = range.first; first < end; first += binBlockSize)
+            tasks.push_back({static_cast<uint32_t>(first), static_cast<uint32_t>(std::min(binBlockSize, end - first))});
+    }
+    if (tasks.empty())
+        return;
+
+    // Projected radius in pixels is radius * pixelScale / depth; depth is view-space -z
+    float pixelScale = projection[1][1] * viewportHeight * 0.5f;
+    glm::vec4 depthRow(-view[0][2], -view[1][2], -view[2][2], -view[3][2]);
+
+    // Bin in parallel blocks, then scatter each block to its slice of every level, so the
+    // order within a level is the instance order and the result is deterministic
+    size_t blocks = tasks.size();
+    std::vector<std::array<size_t, levelCount>> blockCounts(blocks);
+    levelOf.resize(n);
+    ThreadPool& pool = ThreadPool::global();
+    pool.parallelFor(blocks, [&](size_t b) {
+        std::array<size_t, levelCount> counts{};
+        size_t end = tasks[b].first + tasks[b].count;
+        for (size_t i = tasks[b].first; i < end; ++i) {
+            const SphereInstance& inst = instances[i];
+            float depth = glm::dot(depthRow, glm::vec4(inst.position, 1.0f));
+            float pixels = depth > 0.0f ? inst.radius * pixelScale / depth : levelMinPixels[levelCount - 1];
+            int level = levelCount - 1;
+            while (level > 0 && pixels < levelMinPixels[level])
+                --level;
+            levelOf[i] = static_cast<uint8_t>(level);
+            ++counts[level];
+        }
+        blockCounts[b] = counts;
+    });
+
+    std::array<size_t, levelCount> levelStart{};
+    size_t offset = 0;
+    for (int level = 0; level < levelCount; ++level) {
+        levelStart[level] = offset;
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t count = blockCounts[b][level];
+            blockCounts[b][level] = offset;
+            offset += count;
+        }
+        levelInstances[level] = offset - levelStart[level];
+    }
+    size_t drawn = offset;
+    order.resize(drawn);
+    pool.parallelFor(blocks, [&](size_t b) {
+        std::array<size_t, levelCount> cursor = blockCounts[b];
+        size_t end = tasks[b].first + tasks[b].count;
+        for (size_t i = tasks[b].first; i < end; ++i)
+            order[cursor[levelOf[i]]++] = static_cast<uint32_t>(i);
+    });
+
+    idBytes = drawn * sizeof(uint32_t);
+    glBindBuffer(GL_ARRAY_BUFFER, idVBO);
+    // Orphan last frame's ids so the upload does not wait for draws still using them
+    glBufferData(GL_ARRAY_BUFFER, drawn * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, drawn * sizeof(uint32_t), order.data());
+
+    glBindVertexArray(VAO);
+    for (int level = 0; level < levelCount; ++level) {
+        if (levelInstances[level] == 0)
+            continue;
+        // No base instance in GL 3.3: start the id attribute at this level's slice instead
+        glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, sizeof(uint32_t),
+                               (void*)(levelStart[level] * sizeof(uint32_t)));
+        glDrawElementsInstanced(GL_TRIANGLES, levels[level].indexCount, GL_UNSIGNED_INT,
+                                (void*)(levels[level].firstIndex * sizeof(unsigned int)), levelInstances[level]);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,60 @@
+#ifndef SPHERE_LOD_H
+#define SPHERE_LOD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Sphere.h"
+#include "InstanceBuffer.h"
+
+// Sphere meshes at several levels of detail: icospheres subdivided 0-3 times (20 to 1,280
+// triangles). Every frame the instances are binned by their projected radius in pixels
+// and each bin is drawn with one instanced call using the coarsest mesh that still looks
+// round at that size. Instance data is fetched in the vertex shader (atomLodVertex.glsl)
+// from texture buffer views of the InstanceBuffer, indexed through a per-frame list of
+// instance ids sorted by level, so only 4 bytes per atom are uploaded per frame.
+class SphereLOD {
+public:
+    static constexpr int levelCount = 4;
+
+    SphereLOD();
+    ~SphereLOD();
+
+    SphereLOD(const SphereLOD&) = delete;
+    SphereLOD& operator=(const SphereLOD&) = delete;
+
+    // Draws the instances in `ranges`. `instances` must match what instanceBuffer holds;
+    // `viewportHeight` is in pixels.
+    void drawInstances(const InstanceBuffer& instanceBuffer, const std::vector<SphereInstance>& instances,
+                       const std::vector<InstanceRange>& ranges, const glm::mat4& view,
+                       const glm::mat4& projection, float viewportHeight);
+
+    size_t triangleCount(int level) const { return levels[level].indexCount / 3; }
+    // Per-level instance counts and total triangles of the last drawInstances()
+    size_t instancesDrawn(int level) const { return levelInstances[level]; }
+    size_t trianglesLastFrame() const;
+    // Bytes of instance ids uploaded by the last drawInstances()
+    size_t bytesUploadedLastDraw() const { return idBytes; }
+
+private:
+    struct Level {
+        size_t firstIndex;
+        size_t indexCount;
+    };
+
+    void generateMeshes();
+
+    GLuint VAO, VBO, EBO, idVBO;
+    std::array<Level, levelCount> levels;
+
+    // Instance ids sorted by level, rebuilt every frame
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> levelOf;
+    std::array<size_t, levelCount> levelInstances{};
+    size_t idBytes = 0;
+};
+
+#endif
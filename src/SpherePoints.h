@@ -0,0 +1,23 @@
+#ifndef SPHERE_POINTS_H
+#define SPHERE_POINTS_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// `count` evenly spread unit vectors on a golden-angle spiral: the sample points of the
+// SASA dot surface and the sky directions of ambient occlusion
+inline std::vector<glm::vec3> spherePoints(int count) {
+    std::vector<glm::vec3> points(count);
+    const float goldenAngle = 3.14159265f * (3.0f - std::sqrt(5.0f));
+    for (int k = 0; k < count; ++k) {
+        float y = 1.0f - (k + 0.5f) * 2.0f / count;
+        float ring = std::sqrt(std::max(0.0f, 1.0f - y * y));
+        float phi = goldenAngle * k;
+        points[k] = glm::vec3(ring * std::cos(phi), y, ring * std::sin(phi));
+    }
+    return points;
+}
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef STRUCTURE_H
+#define STRUCTURE_H
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+// Fixed-width PDB text fields are stored inline, space padded exactly as in the file
+using AtomName = std::array<char, 4>;       // columns 13-16, e.g. " CA "
+using ResidueName = std::array<char, 3>;    // columns 18-20, e.g. "VAL"
+// Chain identifier, space padded. PDB files only fill the first character (column 22);
+// mmCIF auth_asym_id values use up to all four.
+using ChainId = std::array<char, 4>;
+
+// A MODEL record: index of the first atom that follows it and the model serial number
+struct ModelStart {
+    uint64_t atom;
+    int32_t serial;
+    int32_t reserved;
+};
+
+// A bond listed by a CONECT record, as the serial numbers of its two atoms
+struct ConectBond {
+    int32_t from;
+    int32_t to;
+};
+
+// Secondary structure of a residue
+enum SecondaryType : uint8_t { SecondaryCoil, SecondaryHelix, SecondaryStrand };
+
+// A HELIX or SHEET record (mmCIF struct_conf or struct_sheet_range row): residues first
+// through last of one chain form a helix or a strand
+struct SecondaryRange {
+    ChainId chain;
+    int32_t firstResidue;
+    int32_t lastResidue;
+    char firstInsertion;
+    char lastInsertion;
+    uint8_t type;   // SecondaryType
+    uint8_t reserved;
+};
+
+// Columnar (structure-of-arrays) atom store. Every column has one entry per atom, and
+// atoms keep file order unless reorderAtoms() (AtomOrder.h) sorted them. Kernels that
+// only need a few fields (positions for culling, elements for coloring, ...) stream
+// through tight contiguous arrays.
+struct Structure {
+    // Coordinates in Angstroms
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    // Atomic number, resolved while parsing (0 = unknown element, see Elements.h)
+    std::vector<uint8_t> element;
+    std::vector<int32_t> serial;
+    std::vector<AtomName> atomName;
+    std::vector<char> altLoc;
+    std::vector<ResidueName> residueName;
+    std::vector<int32_t> residueNumber;
+    std::vector<char> insertionCode;
+    std::vector<ChainId> chain;
+    std::vector<float> occupancy;
+    std::vector<float> bFactor;
+    // 1 for HETATM records, 0 for ATOM records
+    std::vector<uint8_t> hetero;
+
+    // Not a column: MODEL boundaries, in atom order. Empty for single-model files.
+    std::vector<ModelStart> models;
+    // Not a column: CONECT bonds in file order. Serial numbers rather than atom indices,
+    // since the records follow the atoms they name.
+    std::vector<ConectBond> conect;
+    // Not a column: HELIX and SHEET records in file order
+    std::vector<SecondaryRange> secondary;
+
+    // Covalent bonds in compressed sparse row form, filled by perceiveBonds() (Bonds.h)
+    // once the structure is complete: the neighbors of atom i are
+    // bondNeighbors[bondOffsets[i], bondOffsets[i + 1]), sorted, each bond listed at both
+    // atoms. Empty until perceived.
+    std::vector<uint32_t> bondOffsets;
+    std::vector<uint32_t> bondNeighbors;
+    // File position of every atom once reorderAtoms() moved them; empty while atoms are
+    // in file order. Export and anything that must follow the file goes through fileIndex().
+    std::vector<uint32_t> fileOrder;
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    glm::vec3 position(size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+    // Atoms i and j have the same chain, residue number and insertion code
+    bool sameResidue(size_t i, size_t j) const {
+        return residueNumber[i] == residueNumber[j] && insertionCode[i] == insertionCode[j] && chain[i] == chain[j];
+    }
+    // Atom i has the given four-character PDB name, padding included (e.g. " CA ")
+    bool isAtomNamed(size_t i, const char* name) const {
+        return std::equal(atomName[i].begin(), atomName[i].end(), name);
+    }
+
+    size_t bondCount() const { return bondNeighbors.size() / 2; }
+    size_t fileIndex(size_t i) const { return fileOrder.empty() ? i : fileOrder[i]; }
+
+    // Calls f(column...) once per per-atom column, passing the same column of each given
+    // structure, so bulk operations cannot miss one
+    template <typename F, typename... S>
+    static void forEachColumn(F&& f, S&... s) {
+        f(s.x...); f(s.y...); f(s.z...);
+        f(s.element...); f(s.serial...); f(s.atomName...); f(s.altLoc...);
+        f(s.residueName...); f(s.residueNumber...); f(s.insertionCode...); f(s.chain...);
+        f(s.occupancy...); f(s.bFactor...); f(s.hetero...);
+    }
+
+    void clear() {
+        forEachColumn([](auto& column) { column.clear(); }, *this);
+        models.clear();
+        conect.clear();
+        secondary.clear();
+        bondOffsets.clear();
+        bondNeighbors.clear();
+        fileOrder.clear();
+    }
+
+    void reserve(size_t n) {
+        forEachColumn([n](auto& column) { column.reserve(n); }, *this);
+    }
+
+    void resize(size_t n) {
+        forEachColumn([n](auto& column) { column.resize(n); }, *this);
+    }
+
+    void shrinkToFit() {
+        forEachColumn([](auto& column) { column.shrink_to_fit(); }, *this);
+    }
+
+    // Appends atoms [first, first + count) of `source`, with the MODEL records among them.
+    // CONECT, HELIX and SHEET records are not tied to an atom range and are left to the caller.
+    void appendRange(const Structure& source, size_t first, size_t count) {
+        size_t offset = size();
+        forEachColumn([first, count](auto& dst, const auto& src) {
+            dst.insert(dst.end(), src.begin() + first, src.begin() + first + count);
+        }, *this, source);
+        for (const ModelStart& model : source.models) {
+            if (model.atom >= first && model.atom < first + count)
+                models.push_back({model.atom - first + offset, model.serial, 0});
+        }
+    }
+
+    // Appends every atom of `source`, with its MODEL, CONECT, HELIX and SHEET records
+    void append(const Structure& source) {
+        size_t offset = size();
+        resize(offset + source.size());
+        copyFrom(source, offset);
+        for (const ModelStart& model : source.models)
+            models.push_back({model.atom + offset, model.serial, 0});
+        conect.insert(conect.end(), source.conect.begin(), source.conect.end());
+        secondary.insert(secondary.end(), source.secondary.begin(), source.secondary.end());
+    }
+
+    // Copy of atoms [first, first + count), without CONECT, HELIX and SHEET records
+    Structure slice(size_t first, size_t count) const {
+        Structure part;
+        part.appendRange(*this, first, count);
+        return part;
+    }
+
+    // Copies every column of `source` into [offset, offset + source.size()); the range must
+    // already exist. Used to merge per-chunk parse results into one store; MODEL, CONECT,
+    // HELIX and SHEET records are left to the caller.
+    void copyFrom(const Structure& source, size_t offset) {
+        forEachColumn([offset](auto& dst, const auto& src) {
+            std::copy(src.begin(), src.end(), dst.begin() + offset);
+        }, *this, source);
+    }
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "StructureCache.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// ---- File layout ----
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint64_t atomCount;
+};
+
+struct CacheSection {
+    uint32_t tag;
+    uint32_t elementSize;
+    uint64_t offset;    // from the start of the file, 64-byte aligned
+    uint64_t count;     // number of elements
+};
+
+static const char cacheMagic[8] = {'P', 'D', 'B', 'C', 'A', 'C', 'H', 'E'};
+static const uint64_t sectionAlignment = 64;
+
+static uint64_t alignUp(uint64_t value) {
+    return (value + sectionAlignment - 1) & ~(sectionAlignment - 1);
+}
+
+// Column sections are tagged 'C' followed by their index in forEachColumn order
+static uint32_t columnTag(uint32_t index) {
+    return ('C' << 24) | index;
+}
+
+// Derived data sections
+static const uint32_t modelsTag = ('M' << 24) | ('O' << 16) | ('D' << 8) | 'L';
+static const uint32_t conectTag = ('C' << 24) | ('O' << 16) | ('N' << 8) | 'E';
+static const uint32_t secondaryTag = ('S' << 24) | ('E' << 16) | ('C' << 8) | 'S';
+static const uint32_t bondOffsetsTag = ('B' << 24) | ('O' << 16) | ('F' << 8) | 'F';
+static const uint32_t bondNeighborsTag = ('B' << 24) | ('N' << 16) | ('B' << 8) | 'R';
+
+static size_t columnCount() {
+    size_t n = 0;
+    Structure empty;
+    Structure::forEachColumn([&n](auto&) { ++n; }, empty);
+    return n;
+}
+
+// ---- Content hash ----
+static inline uint64_t load64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Four independent multiply-rotate lanes over 32-byte strides, so the loop is not
+// bound by a single dependency chain
+static uint64_t hashBlock(const char* data, size_t size, uint64_t seed) {
+    const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t lanes[4] = {seed + prime1, seed + prime2, seed, seed - prime1};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t v = lanes[lane] + load64(data + i + lane * 8) * prime2;
+            lanes[lane] = ((v << 31) | (v >> 33)) * prime1;
+        }
+    }
+    uint64_t h = size;
+    for (int lane = 0; lane < 4; ++lane)
+        h = mix(h ^ lanes[lane]) * prime1;
+    for (; i < size; ++i)
+        h = (h ^ static_cast<uint8_t>(data[i])) * prime1;
+    return mix(h);
+}
+
+uint64_t StructureCache::hashContent(std::string_view data, ThreadPool& pool) {
+    const size_t blockSize = 1u << 20;
+    size_t blockCount = (data.size() + blockSize - 1) / blockSize;
+    std::vector<uint64_t> blockHashes(blockCount);
+    pool.parallelFor(blockCount, [&](size_t b) {
+        size_t begin = b * blockSize;
+        size_t size = std::min(blockSize, data.size() - begin);
+        blockHashes[b] = hashBlock(data.data() + begin, size, b);
+    });
+    return hashBlock(reinterpret_cast<const char*>(blockHashes.data()),
+                     blockHashes.size() * sizeof(uint64_t), data.size());
+}
+
+// ---- Paths ----
+std::string StructureCache::sidecarPath(const std::string& sourcePath) {
+    return sourcePath + ".cache";
+}
+
+std::string StructureCache::cacheDirectoryPath(uint64_t sourceHash, uint64_t sourceSize) {
+    std::filesystem::path dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0')
+        dir = xdg;
+    else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+        dir = std::filesystem::path(home) / ".cache";
+    else
+        dir = std::filesystem::temp_directory_path();
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%llu.cache",
+             static_cast<unsigned long long>(sourceHash), static_cast<unsigned long long>(sourceSize));
+    return (dir / "pdb-viewer" / name).string();
+}
+
+// ---- Load / save ----
+bool StructureCache::load(const std::string& sourcePath, uint64_t sourceSize, uint64_t sourceHash, Structure& structure) {
+    return loadFrom(sidecarPath(sourcePath), sourceSize, sourceHash, structure) ||
+           loadFrom(cacheDirectoryPath(sourceHash, sourceSize), sourceSize, sourceHash, structure);
+}
+
+bool StructureCache::save(const std::string& sourcePath, uint64_t sourceSize, uint64_t sourceHash,
+                          const std::vector<const Structure*>& parts, const Structure* bonded) {
+    if (saveTo(sidecarPath(sourcePath), sourceSize, sourceHash, parts, bonded))
+        return true;
+    std::string fallback = cacheDirectoryPath(sourceHash, sourceSize);
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(fallback).parent_path(), ec);
+    return saveTo(fallback, sourceSize, sourceHash, parts, bonded);
+}
+
+bool StructureCache::loadFrom(const std::string& cachePath, uint64_t sourceSize, uint64_t sourceHash, Structure& structure) {
+    MappedFile file;
+    if (!file.open(cachePath) || file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    size_t columns = columnCount();
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        header.version != formatVersion ||
+        header.sourceSize != sourceSize ||
+        header.sourceHash != sourceHash ||
+        header.sectionCount < columns ||
+        sizeof(CacheHeader) + header.sectionCount * sizeof(CacheSection) > file.size())
+        return false;
+
+    std::vector<CacheSection> sections(header.sectionCount);
+    std::memcpy(sections.data(), file.data() + sizeof(CacheHeader), sections.size() * sizeof(CacheSection));
+
+    // Validate every column section before touching the store
+    for (size_t i = 0; i < columns; ++i) {
+        const CacheSection& section = sections[i];
+        if (section.tag != columnTag(static_cast<uint32_t>(i)) ||
+            section.count != header.atomCount ||
+            section.offset + section.count * section.elementSize > file.size())
+            return false;
+    }
+
+    Structure loaded;
+    size_t column = 0;
+    bool valid = true;
+    Structure::forEachColumn([&](auto& dst) {
+        using T = typename std::remove_reference_t<decltype(dst)>::value_type;
+        const CacheSection& section = sections[column++];
+        if (section.elementSize != sizeof(T)) {
+            valid = false;
+            return;
+        }
+        dst.resize(section.count);
+        std::memcpy(dst.data(), file.data() + section.offset, section.count * sizeof(T));
+    }, loaded);
+    if (!valid)
+        return false;
+
+    auto readSection = [&](const CacheSection& section, auto& records) {
+        using T = typename std::remove_reference_t<decltype(records)>::value_type;
+        if (section.elementSize != sizeof(T) || section.offset + section.count * sizeof(T) > file.size())
+            return false;
+        records.resize(section.count);
+        std::memcpy(records.data(), file.data() + section.offset, section.count * sizeof(T));
+        return true;
+    };
+    for (size_t i = columns; i < sections.size(); ++i) {
+        const CacheSection& section = sections[i];
+        if (section.tag == modelsTag && !readSection(section, loaded.models))
+            return false;
+        if (section.tag == conectTag && !readSection(section, loaded.conect))
+            return false;
+        if (section.tag == secondaryTag && !readSection(section, loaded.secondary))
+            return false;
+        if (section.tag == bondOffsetsTag && !readSection(section, loaded.bondOffsets))
+            return false;
+        if (section.tag == bondNeighborsTag && !readSection(section, loaded.bondNeighbors))
+            return false;
+    }
+    // Bonds are all or nothing: offsets for at most every atom, ending at the neighbor count
+    if (loaded.bondOffsets.empty() ? !loaded.bondNeighbors.empty()
+                                   : loaded.bondOffsets.size() > header.atomCount + 1 ||
+                                     loaded.bondOffsets.back() != loaded.bondNeighbors.size())
+        return false;
+
+    structure = std::move(loaded);
+    return true;
+}
+
+bool StructureCache::saveTo(const std::string& cachePath, uint64_t sourceSize, uint64_t sourceHash,
+                            const std::vector<const Structure*>& parts, const Structure* bonded) {
+    uint64_t atomCount = 0;
+    for (const Structure* part : parts)
+        atomCount += part->size();
+
+    static const std::vector<uint32_t> noBonds;
+    bool withBonds = bonded != nullptr && !bonded->bondOffsets.empty() && bonded->bondOffsets.size() <= atomCount + 1;
+    const std::vector<uint32_t>& bondOffsets = withBonds ? bonded->bondOffsets : noBonds;
+    const std::vector<uint32_t>& bondNeighbors = withBonds ? bonded->bondNeighbors : noBonds;
+
+    std::vector<ModelStart> models;
+    std::vector<ConectBond> conect;
+    std::vector<SecondaryRange> secondary;
+    uint64_t partOffset = 0;
+    for (const Structure* part : parts) {
+        for (const ModelStart& model : part->models)
+            models.push_back({model.atom + partOffset, model.serial, 0});
+        conect.insert(conect.end(), part->conect.begin(), part->conect.end());
+        secondary.insert(secondary.end(), part->secondary.begin(), part->secondary.end());
+        partOffset += part->size();
+    }
+
+    // Every column has atomCount entries, so section offsets only depend on element sizes.
+    // Sections: the columns, then the MODEL, CONECT and HELIX/SHEET lists and the bonds.
+    size_t columnSections = columnCount();
+    std::vector<CacheSection> sections;
+    uint64_t offset = alignUp(sizeof(CacheHeader) + (columnSections + 5) * sizeof(CacheSection));
+    uint32_t column = 0;
+    Structure layout;
+    Structure::forEachColumn([&](const auto& src) {
+        using T = typename std::remove_reference_t<decltype(src)>::value_type;
+        sections.push_back({columnTag(column++), static_cast<uint32_t>(sizeof(T)), offset, atomCount});
+        offset = alignUp(offset + atomCount * sizeof(T));
+    }, layout);
+
+    sections.push_back({modelsTag, static_cast<uint32_t>(sizeof(ModelStart)), offset, models.size()});
+    offset = alignUp(offset + models.size() * sizeof(ModelStart));
+    sections.push_back({conectTag, static_cast<uint32_t>(sizeof(ConectBond)), offset, conect.size()});
+    offset = alignUp(offset + conect.size() * sizeof(ConectBond));
+    sections.push_back({secondaryTag, static_cast<uint32_t>(sizeof(SecondaryRange)), offset, secondary.size()});
+    offset = alignUp(offset + secondary.size() * sizeof(SecondaryRange));
+    sections.push_back({bondOffsetsTag, static_cast<uint32_t>(sizeof(uint32_t)), offset, bondOffsets.size()});
+    offset = alignUp(offset + bondOffsets.size() * sizeof(uint32_t));
+    sections.push_back({bondNeighborsTag, static_cast<uint32_t>(sizeof(uint32_t)), offset, bondNeighbors.size()});
+
+    CacheHeader header;
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = formatVersion;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.sourceSize = sourceSize;
+    header.sourceHash = sourceHash;
+    header.atomCount = atomCount;
+
+    // Write to a temporary name first so a crash never leaves a truncated cache behind
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(CacheSection));
+
+    // Column by column, each one concatenated across the parts
+    const char padding[sectionAlignment] = {};
+    for (size_t index = 0; index < columnSections; ++index) {
+        uint64_t position = static_cast<uint64_t>(out.tellp());
+        out.write(padding, sections[index].offset - position);
+        for (const Structure* part : parts) {
+            size_t current = 0;
+            Structure::forEachColumn([&](const auto& src) {
+                using T = typename std::remove_reference_t<decltype(src)>::value_type;
+                if (current++ == index)
+                    out.write(reinterpret_cast<const char*>(src.data()), src.size() * sizeof(T));
+            }, *part);
+        }
+    }
+    uint64_t position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, sections[columnSections].offset - position);
+    out.write(reinterpret_cast<const char*>(models.data()), models.size() * sizeof(ModelStart));
+    position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, sections[columnSections + 1].offset - position);
+    out.write(reinterpret_cast<const char*>(conect.data()), conect.size() * sizeof(ConectBond));
+    position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, sections[columnSections + 2].offset - position);
+    out.write(reinterpret_cast<const char*>(secondary.data()), secondary.size() * sizeof(SecondaryRange));
+    position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, sections[columnSections + 3].offset - position);
+    out.write(reinterpret_cast<const char*>(bondOffsets.data()), bondOffsets.size() * sizeof(uint32_t));
+    position = static_cast<uint64_t>(out.tellp());
+    out.write(padding, sections[columnSections + 4].offset - position);
+    out.write(reinterpret_cast<const char*>(bondNeighbors.data()), bondNeighbors.size() * sizeof(uint32_t));
+    out.close();
+    if (!out) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
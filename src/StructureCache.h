@@ -0,0 +1,52 @@
+#ifndef STRUCTURE_CACHE_H
+#define STRUCTURE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Structure.h"
+#include "ThreadPool.h"
+
+// Versioned binary sidecar holding the parsed columns of a structure, so reopening a large
+// file skips the text parser. Entries are keyed by the size and a 64-bit content hash of
+// the source file; a mismatch of either (or of the format version) means a re-parse.
+//
+// Layout: CacheHeader, CacheSection table, then one 64-byte aligned blob per section.
+// The first sections are the Structure columns in Structure::forEachColumn order; derived
+// data is appended as further tagged sections (currently the MODEL, CONECT and HELIX/SHEET record lists,
+// and the perceived bonds as bondOffsets/bondNeighbors over the atoms of the first model).
+class StructureCache
+{
+public:
+    // Bump whenever a column or section changes meaning or layout
+    static const uint32_t formatVersion = 6;
+
+    // Hashes the file contents in parallel 1 MB blocks
+    static uint64_t hashContent(std::string_view data, ThreadPool& pool);
+
+    // Sidecar path next to the source file ("2PGH.pdb" -> "2PGH.pdb.cache")
+    static std::string sidecarPath(const std::string& sourcePath);
+    // Fallback location when the source directory is not writable
+    static std::string cacheDirectoryPath(uint64_t sourceHash, uint64_t sourceSize);
+
+    // Fills `structure` from the first valid cache for this source; false on a miss. Bonds
+    // come back in file order if they were saved, and cover the atoms of the first model.
+    static bool load(const std::string& sourcePath, uint64_t sourceSize, uint64_t sourceHash, Structure& structure);
+    // Writes a cache entry for this source, next to it if possible, otherwise in the cache directory.
+    // The structure may be given as consecutive parts (e.g. parse batches), which are
+    // written as if concatenated. The bonds of `bonded` are stored with them; they must be
+    // numbered in file order, over the first-model atoms at the start of the parts.
+    static bool save(const std::string& sourcePath, uint64_t sourceSize, uint64_t sourceHash,
+                     const std::vector<const Structure*>& parts, const Structure* bonded = nullptr);
+    static bool save(const std::string& sourcePath, uint64_t sourceSize, uint64_t sourceHash, const Structure& structure) {
+        return save(sourcePath, sourceSize, sourceHash, std::vector<const Structure*>{&structure}, &structure);
+    }
+
+private:
+    static bool loadFrom(const std::string& cachePath, uint64_t sourceSize, uint64_t sourceHash, Structure& structure);
+    static bool saveTo(const std::string& cachePath, uint64_t sourceSize, uint64_t sourceHash,
+                       const std::vector<const Structure*>& parts, const Structure* bonded);
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "SurfaceBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+struct SurfaceVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    uint8_t color[4];
+};
+
+uint8_t colorByte(float channel) {
+    return static_cast<uint8_t>(std::clamp(channel, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+std::vector<SurfaceVertex> packVertices(const SurfaceMesh& mesh, size_t first, size_t count) {
+    std::vector<SurfaceVertex> vertices(count);
+    for (size_t i = 0; i < count; ++i) {
+        vertices[i].position = mesh.positions[first + i];
+        vertices[i].normal = mesh.normals[first + i];
+        const glm::vec3& color = mesh.colors[first + i];
+        vertices[i].color[0] = colorByte(color.r);
+        vertices[i].color[1] = colorByte(color.g);
+        vertices[i].color[2] = colorByte(color.b);
+        vertices[i].color[3] = 255;
+    }
+    return vertices;
+}
+
+} // namespace
+
+SurfaceBuffer::~SurfaceBuffer() {
+    release();
+}
+
+void SurfaceBuffer::upload(const SurfaceMesh& mesh) {
+    std::vector<SurfaceVertex> vertices = packVertices(mesh, 0, mesh.vertexCount());
+
+    if (VAO == 0) {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SurfaceVertex), (void*)offsetof(SurfaceVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SurfaceVertex), (void*)offsetof(SurfaceVertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SurfaceVertex), (void*)offsetof(SurfaceVertex, color));
+        glEnableVertexAttribArray(2);
+    } else {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    }
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SurfaceVertex), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    indexCount = mesh.indices.size();
+}
+
+void SurfaceBuffer::updateVertices(const SurfaceMesh& mesh, size_t first, size_t count) {
+    if (VAO == 0 || count == 0)
+        return;
+    std::vector<SurfaceVertex> vertices = packVertices(mesh, first, count);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(SurfaceVertex), count * sizeof(SurfaceVertex), vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SurfaceBuffer::clear() {
+    indexCount = 0;
+}
+
+void SurfaceBuffer::release() {
+    clear();
+    if (VAO != 0)
+        glDeleteVertexArrays(1, &VAO);
+    if (VBO != 0)
+        glDeleteBuffers(1, &VBO);
+    if (EBO != 0)
+        glDeleteBuffers(1, &EBO);
+    VAO = VBO = EBO = 0;
+}
+
+void SurfaceBuffer::draw() const {
+    if (indexCount == 0)
+        return;
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
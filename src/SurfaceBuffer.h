@@ -0,0 +1,37 @@
+#ifndef SURFACE_BUFFER_H
+#define SURFACE_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include "IsoSurface.h"
+
+// GPU copy of a surface mesh, drawn as one indexed triangle list. Vertices are interleaved
+// as position, normal and an RGBA8 color, at attribute locations 0, 1 and 2.
+class SurfaceBuffer {
+public:
+    SurfaceBuffer() = default;
+    ~SurfaceBuffer();
+
+    SurfaceBuffer(const SurfaceBuffer&) = delete;
+    SurfaceBuffer& operator=(const SurfaceBuffer&) = delete;
+
+    // Replaces the buffer contents with `mesh`
+    void upload(const SurfaceMesh& mesh);
+    // Rewrites vertices [first, first + count) from `mesh`, which must have the topology of
+    // the last upload
+    void updateVertices(const SurfaceMesh& mesh, size_t first, size_t count);
+    void clear();
+    // Deletes the GL objects as well; must run while the context is current
+    void release();
+
+    // Draws the mesh with whatever shader is bound
+    void draw() const;
+
+    size_t triangleCount() const { return indexCount / 3; }
+
+private:
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    size_t indexCount = 0;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+// Fixed set of worker threads that run index-parallel loops. parallelFor() may be called
+// from several threads at once (e.g. a loader thread and the render thread); every caller
+// helps execute its own loop, so nested or concurrent loops never deadlock.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+        // The calling thread always participates, so spawn one worker fewer
+        for (unsigned i = 1; i < threadCount; ++i)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads a loop can run on, including the caller
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Runs job(i) for every i in [0, count) and returns once all calls have finished
+    void parallelFor(size_t count, const std::function<void(size_t)>& job) {
+        if (count == 0)
+            return;
+        if (count == 1 || workers.empty()) {
+            for (size_t i = 0; i < count; ++i)
+                job(i);
+            return;
+        }
+
+        auto batch = std::make_shared<Batch>();
+        batch->job = &job;
+        batch->count = count;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(batch);
+        }
+        wake.notify_all();
+
+        runBatch(*batch);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return batch->done.load() == batch->count; });
+        removeBatch(batch);
+    }
+
+    // Shared pool sized to the machine, used by parsing and geometry kernels
+    static ThreadPool& global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+private:
+    struct Batch {
+        const std::function<void(size_t)>* job = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            std::shared_ptr<Batch> batch = queue.front();
+            lock.unlock();
+            runBatch(*batch);
+            lock.lock();
+            // Every index has been claimed; stop handing this batch out
+            removeBatch(batch);
+        }
+    }
+
+    void runBatch(Batch& batch) {
+        size_t i;
+        while ((i = batch.next.fetch_add(1)) < batch.count) {
+            (*batch.job)(i);
+            if (batch.done.fetch_add(1) + 1 == batch.count) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    // Caller must hold the mutex
+    void removeBatch(const std::shared_ptr<Batch>& batch) {
+        auto it = std::find(queue.begin(), queue.end(), batch);
+        if (it != queue.end())
+            queue.erase(it);
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::shared_ptr<Batch>> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool stopping = false;
+};
+#endif
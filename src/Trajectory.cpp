@@ -0,0 +1,110 @@
+#include "Trajectory.h"
+#include <algorithm>
+
+void Trajectory::clear() {
+    topologyFinal = false;
+    atomCount = 0;
+    modelsSeen = 0;
+    frameAtoms = 0;
+    serials.clear();
+    coordinates.clear();
+}
+
+// Called when the second model starts: the topology is complete, and its coordinates
+// become frame 0
+void Trajectory::finalizeTopology(const Structure& topology) {
+    topologyFinal = true;
+    atomCount = topology.size();
+    coordinates.resize(atomCount * 3);
+    for (size_t i = 0; i < atomCount; ++i) {
+        coordinates[i * 3 + 0] = topology.x[i];
+        coordinates[i * 3 + 1] = topology.y[i];
+        coordinates[i * 3 + 2] = topology.z[i];
+    }
+}
+
+// New frames start as a copy of frame 0, which covers models with missing atoms
+void Trajectory::beginFrame(int serial) {
+    coordinates.insert(coordinates.end(), coordinates.begin(), coordinates.begin() + atomCount * 3);
+    serials.push_back(serial);
+    frameAtoms = 0;
+}
+
+void Trajectory::addBatch(const Structure& batch, Structure& topology) {
+    size_t cursor = 0;
+    size_t nextModel = 0;
+    while (cursor < batch.size() || nextModel < batch.models.size()) {
+        // Atoms up to the next MODEL record belong to the current model
+        size_t segmentEnd = nextModel < batch.models.size()
+            ? static_cast<size_t>(batch.models[nextModel].atom) : batch.size();
+        if (!topologyFinal) {
+            topology.appendRange(batch, cursor, segmentEnd - cursor);
+            // Model boundaries now live in the trajectory, not the topology
+            topology.models.clear();
+        } else {
+            float* target = coordinates.data() + (coordinates.size() - atomCount * 3);
+            for (size_t i = cursor; i < segmentEnd && frameAtoms < atomCount; ++i, ++frameAtoms) {
+                target[frameAtoms * 3 + 0] = batch.x[i];
+                target[frameAtoms * 3 + 1] = batch.y[i];
+                target[frameAtoms * 3 + 2] = batch.z[i];
+            }
+        }
+        cursor = segmentEnd;
+
+        if (nextModel < batch.models.size()) {
+            int serial = batch.models[nextModel].serial;
+            ++nextModel;
+            ++modelsSeen;
+            if (modelsSeen == 1) {
+                serials.assign(1, serial);
+            } else {
+                if (!topologyFinal)
+                    finalizeTopology(topology);
+                beginFrame(serial);
+            }
+        }
+    }
+    topology.conect.insert(topology.conect.end(), batch.conect.begin(), batch.conect.end());
+    topology.secondary.insert(topology.secondary.end(), batch.secondary.begin(), batch.secondary.end());
+}
+
+size_t Trajectory::frameCount() const {
+    if (!topologyFinal)
+        return 1;
+    return atomCount == 0 ? 1 : coordinates.size() / (atomCount * 3);
+}
+
+int Trajectory::modelSerial(size_t f) const {
+    return f < serials.size() ? serials[f] : 0;
+}
+
+const float* Trajectory::frame(size_t f) const {
+    return coordinates.data() + f * atomCount * 3;
+}
+
+void Trajectory::applyFrame(size_t f, Structure& topology) const {
+    if (!topologyFinal || f >= frameCount() || topology.size() != atomCount)
+        return;
+    const float* source = frame(f);
+    for (size_t i = 0; i < atomCount; ++i) {
+        topology.x[i] = source[i * 3 + 0];
+        topology.y[i] = source[i * 3 + 1];
+        topology.z[i] = source[i * 3 + 2];
+    }
+}
+
+void Trajectory::reorder(const std::vector<uint32_t>& order) {
+    if (!topologyFinal || order.size() != atomCount)
+        return;
+    std::vector<float> sorted(coordinates.size());
+    for (size_t f = 0; f < frameCount(); ++f) {
+        const float* source = frame(f);
+        float* target = sorted.data() + f * atomCount * 3;
+        for (size_t i = 0; i < atomCount; ++i) {
+            target[i * 3 + 0] = source[order[i] * 3 + 0];
+            target[i * 3 + 1] = source[order[i] * 3 + 1];
+            target[i * 3 + 2] = source[order[i] * 3 + 2];
+        }
+    }
+    coordinates.swap(sorted);
+}
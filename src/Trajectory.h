@@ -0,0 +1,47 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Structure.h"
+
+// Coordinate frames of a multi-MODEL PDB file (NMR ensemble or trajectory). The topology
+// (every non-coordinate column) is taken from the first model only; each model is kept
+// as a compact interleaved xyz frame that shares it.
+class Trajectory
+{
+public:
+    void clear();
+
+    // Routes a parsed batch, in file order: atoms of the first model extend `topology`,
+    // atoms of later models are written into their coordinate frame. A model with fewer
+    // atoms than the first keeps the first model's coordinates for the missing ones;
+    // surplus atoms are dropped. CONECT records always go to the topology.
+    void addBatch(const Structure& batch, Structure& topology);
+
+    // Number of frames, at least 1 once the topology has atoms
+    size_t frameCount() const;
+    // Serial number from the MODEL record of frame f (0 when the file has none)
+    int modelSerial(size_t f) const;
+    // Interleaved xyz coordinates of frame f, 3 * atomCount floats
+    const float* frame(size_t f) const;
+    // Overwrites the coordinate columns of `topology` with frame f
+    void applyFrame(size_t f, Structure& topology) const;
+    // Moves every frame's atoms to their place in `order` after the topology was reordered
+    // (see AtomOrder.h)
+    void reorder(const std::vector<uint32_t>& order);
+
+private:
+    void finalizeTopology(const Structure& topology);
+    void beginFrame(int serial);
+
+    bool topologyFinal = false;
+    size_t atomCount = 0;
+    size_t modelsSeen = 0;
+    size_t frameAtoms = 0;
+    std::vector<int> serials;
+    std::vector<float> coordinates;
+};
+
+#endif
@@ -25,19 +25,95 @@
 #include <stdio.h>
 #include <filesystem>
 #include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <array>
 // Shader class
 #include "shader.h"
 // Camera class
 #include "flyCamera.h"
 // Sphere class
 #include "Sphere.h"
+#include "SphereImpostor.h"
+#include "SphereLOD.h"
+// Frustum and occlusion culling
+#include "ClusterBVH.h"
+#include "OcclusionCuller.h"
+// Persistent GPU instance store
+#include "InstanceBuffer.h"
+#include "BondBuffer.h"
+#include "BondImpostor.h"
+// PDB file parsing
+#include "MappedFile.h"
+#include "PDBParser.h"
+// Columnar atom store
+#include "Structure.h"
+#include "Bonds.h"
+#include "SpatialIndex.h"
+#include "AtomOrder.h"
+#include "Sasa.h"
+#include "MolecularSurface.h"
+#include "SurfaceBuffer.h"
+#include "Cartoon.h"
+#include "SecondaryStructure.h"
+#include "AmbientOcclusion.h"
+#include "StructureCache.h"
+#include "AsyncLoader.h"
+#include "Trajectory.h"
+// Periodic table
+#include "Elements.h"
+
+// Everything needed to draw the atoms with any of the renderers
+struct AtomRenderers {
+    Shader& meshShader;
+    // The mesh shader without the uniform-scale fast path, kept for benchmarks
+    Shader& referenceMeshShader;
+    Shader& impostorShader;
+    Shader& lodShader;
+    Shader& bondShader;
+    Sphere& sphere;
+    SphereImpostor& impostor;
+    SphereLOD& lod;
+    BondImpostor& bonds;
+};
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 void loadPDBFile(const std::string& filePath);
+void appendAtoms(const Structure& batch);
+void pollLoader();
+float atomRadius(uint8_t element);
+float atomRadius(uint8_t element, int style);
+void prepareLoadedStructure(Structure& loaded, Trajectory& frames, bool spatialOrdering, int style);
+void applyAtomStyle();
+void updateAmbientOcclusion();
+void invalidateAmbientOcclusion();
+void updateSASA();
+void applyColorMode();
+void exportSASA();
+void updateSurface(const std::vector<glm::vec3>& palette);
+void drawSurface(Shader& shader, const glm::mat4& view, const glm::mat4& projection);
+void updateCartoon();
+void drawCartoon(Shader& shader, const glm::mat4& view, const glm::mat4& projection);
+void showFrame(int frame);
+bool timelineMoving();
+bool surfaceFollowsTimeline();
+void updatePlayback(float dt);
+void benchmarkParserScaling(const std::string& filePath);
+void benchmarkSpatialIndex();
+void benchmarkAtomOrder();
+void setSceneUniforms(Shader& shader, const glm::mat4& view, const glm::mat4& projection);
+size_t drawAtoms(AtomRenderers& renderers, int renderer, const glm::mat4& view, const glm::mat4& projection,
+                 float viewportHeight);
+size_t drawBonds(AtomRenderers& renderers, const glm::mat4& view, const glm::mat4& projection);
+void benchmarkSphereRenderers(AtomRenderers& renderers, const glm::mat4& view, const glm::mat4& projection,
+                              float viewportHeight);
+void benchmarkMeshShaderVariants(AtomRenderers& renderers, const glm::mat4& view, const glm::mat4& projection);
 void drawGui();
+void runViewer(GLFWwindow* window);
 
 unsigned int loadTexture(const char *path);
 
@@ -58,40 +134,133 @@ float lastFrame = 0.0f;
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
-// cpk coloring map
-std::unordered_map<std::string, glm::vec3> elementColors = {
-    {"C", glm::vec3(0.784f, 0.784f, 0.784f)},   // gray
-    {"O", glm::vec3(0.941f, 0.0f, 0.0f)},   // red
-    {"N", glm::vec3(0.561f, 0.561f, 1.0f)},   // light blue
-    {"H", glm::vec3(1.0f, 1.0f, 1.0f)},   // white
-    {"S", glm::vec3(1.0f, 0.784f, 0.0f)},   // yellow
-    {"P", glm::vec3(1.0f, 0.647f, 0.0f)},   // orange
-    {"NA", glm::vec3(0.0f, 0.0f, 1.0f)},   // blue
-    {"CL", glm::vec3(0.0f, 1.0f, 0.0f)},   // green
-    {"FE", glm::vec3(1.0f, 0.647f, 0.0f)},   // orange
-    {"CA", glm::vec3(0.502f, 0.502f, 0.565f)},   // dark grey
-    {"BR", glm::vec3(0.647f, 0.165f, 0.165f)},   // brown
-    {"MG", glm::vec3(0.133f, 0.545f, 0.133f)},   // forest green
-};
+// Rendered sphere radius as a fraction of the van der Waals radius
+const float atomRadiusScale = 0.6f;
+// How atoms and bonds are shown; the bond styles draw the perceived bonds as cylinders
+enum AtomStyle { StyleSpaceFilling, StyleBallAndStick, StyleLicorice, AtomStyleCount };
+const char* const atomStyleNames[AtomStyleCount] = { "Space filling", "Ball and stick", "Licorice" };
+int atomStyle = StyleSpaceFilling;
+// Ball-and-stick spheres are a smaller fraction of the van der Waals radius
+const float ballRadiusScale = 0.25f;
+const float ballAndStickBondRadius = 0.15f;
+// Licorice atoms are spheres as wide as the bonds, which round off the joints
+const float licoriceRadius = 0.25f;
+// How atoms are colored. Solvent accessibility runs from blue (buried) over white to red
+// (exposed) through the palette entries from sasaPaletteFirst on.
+enum ColorMode { ColorByElement, ColorBySASA, ColorModeCount };
+const char* const colorModeNames[ColorModeCount] = { "Element", "Solvent accessibility" };
+int colorMode = ColorByElement;
+const size_t sasaPaletteFirst = 128;
+// Per-atom solvent-accessible surface area of the current frame; empty until needed
+std::vector<float> atomSASA;
+// Accessibility colors belong to an earlier frame; recolored once the timeline comes to rest,
+// since a Shrake-Rupley pass per frame step would stall playback
+bool sasaColorsStale = false;
+// Per-atom ambient occlusion, stored in the instances (see AmbientOcclusion.h). Recomputed
+// in the background when atoms or radii change, once the timeline has come to rest.
+bool ambientOcclusion = true;
+AmbientOcclusionJob ambientOcclusionJob;
+// Bumped by every change that invalidates the shading; results of older generations are dropped
+uint64_t ambientOcclusionGeneration = 0;
+uint64_t ambientOcclusionStarted = 0;
+// Time of the last change; a job starts only after ambientOcclusionDelay seconds without one
+double ambientOcclusionChangedAt = 0.0;
+const double ambientOcclusionDelay = 0.25;
+double ambientOcclusionMilliseconds = 0.0;
+// Molecular surface drawn along with the atoms, meshed at surfaceResolution Angstroms
+enum SurfaceMode { SurfaceNone, SurfaceExcluded, SurfaceAccessible, SurfaceGaussian, SurfaceModeCount };
+const char* const surfaceModeNames[SurfaceModeCount] = { "None", "Solvent excluded", "Solvent accessible", "Gaussian density" };
+int surfaceMode = SurfaceNone;
+float surfaceResolution = 0.5f;
+// Gaussian width as a fraction of the van der Waals radius (see MolecularSurface.h)
+float gaussianWidth = 0.5f;
+// Set when atoms, coordinates or colors change; the surface is rebuilt before the next draw
+bool surfaceDirty = false;
+double surfaceBuildMilliseconds = 0.0;
+// Backbone cartoon, drawn with or instead of the atoms (see Cartoon.h)
+bool showCartoon = false;
+bool showAtoms = true;
+// Set when atoms or coordinates change; only traces that moved are regenerated
+bool cartoonDirty = false;
+double cartoonBuildMilliseconds = 0.0;
+// Where the cartoon's helices and strands come from. Files without HELIX/SHEET records
+// always get them computed from the backbone (see SecondaryStructure.h), every frame.
+enum SecondarySource { SecondaryFromFile, SecondaryComputed, SecondarySourceCount };
+const char* const secondarySourceNames[SecondarySourceCount] = { "File records", "Computed (DSSP)" };
+int secondarySource = SecondaryFromFile;
+std::vector<SecondaryRange> computedSecondary;
+double secondaryMilliseconds = 0.0;
 
-// cpk atomic radii in Angstroms (divided by 100)
-std::unordered_map<std::string, float> elementRadii = {
-    {"C", 1.70f},
-    {"O", 1.52f},
-    {"N", 1.55f},
-    {"H", 1.20f},
-    {"S", 1.80f},
-    {"P", 1.80f},
-    {"NA", 2.27f},
-    {"CL", 1.75f},
-    {"FE", 1.94f},
-    {"CA", 1.97f},    
-    {"BR", 1.85f},
-    {"MG", 1.73f},
-};
+// Parsed atoms, one column per PDB field
+Structure structure;
+
+// Coordinate frames of multi-MODEL files, sharing the topology in `structure`
+Trajectory trajectory;
+
+// MODEL records among the batches streamed so far; atoms after the second one belong to
+// later frames and are not drawn while the file loads
+size_t streamedModels = 0;
+
+// timeline playback
+int currentFrame = 0;
+bool playing = false;
+bool loopPlayback = true;
+float playbackFps = 10.0f;
+float playbackTimer = 0.0f;
+// The frame slider is being dragged; like playback, frames may change every render frame
+bool scrubbingTimeline = false;
 
 // Instances is now a global variable so the functions can access it anywhere
 std::vector<SphereInstance> instances;
+// GPU copy of instances; filled once per load, then only dirty ranges are re-uploaded
+InstanceBuffer instanceBuffer;
+// Bonded atom index pairs, uploaded once the structure is complete
+BondBuffer bondBuffer;
+// Mesh of the current surface
+SurfaceBuffer surfaceBuffer;
+// Cartoon geometry and its GPU copy
+Cartoon cartoon;
+SurfaceBuffer cartoonBuffer;
+// Read/write binary sidecars so reopening a file skips the text parser
+bool useStructureCache = true;
+// Sort atoms along a space-filling curve once loaded (see AtomOrder.h)
+bool spatialAtomOrder = false;
+// Background file loader
+AsyncLoader loader;
+// Draw data for a finished load, built on the loader thread by prepareLoadedStructure() and
+// swapped in by pollLoader(); only the loader thread touches it while a load runs
+struct LoadedScene {
+    std::vector<SphereInstance> instances;
+    ClusterBVH clusterBVH;
+    // Atom style the radii were computed for
+    int atomStyle = 0;
+    // The atoms were sorted into spatial order and no longer match the streamed batches
+    bool reordered = false;
+    double orderMilliseconds = 0.0;
+};
+LoadedScene loadedScene;
+// Most recently opened file, used by the parser scaling benchmark
+std::string currentFilePath;
+// How atoms are drawn: ray-cast quads, or the sphere mesh with or without level of detail
+enum AtomRenderer { RenderImpostors, RenderMeshLOD, RenderMesh, AtomRendererCount };
+const char* const atomRendererNames[AtomRendererCount] = { "Ray-cast impostors", "Mesh, level of detail", "Mesh, full detail" };
+int atomRenderer = RenderImpostors;
+// Triangles submitted for the atoms last frame, for the throughput readout
+size_t atomTrianglesLastFrame = 0;
+std::array<size_t, SphereLOD::levelCount> lodInstancesLastFrame{};
+// Residue clusters of the loaded structure, culled against the view frustum every frame
+ClusterBVH clusterBVH;
+bool frustumCulling = true;
+// Two-pass hierarchical-Z occlusion culling on top of the frustum test
+bool occlusionCulling = true;
+// Set when the clusters change, so last frame's visibility is not reused
+bool occlusionHistoryStale = false;
+size_t occlusionClustersDrawn = 0;
+size_t occlusionClustersHidden = 0;
+// Instance ranges drawn by the current pass
+std::vector<InstanceRange> visibleRanges;
+// Set from the GUI; the benchmark runs inside the next frame, where the GL state is set up
+bool benchmarkRenderersRequested = false;
 
 int main() {
     // Instantiate GLFW window
@@ -137,11 +306,73 @@ int main() {
     // Enable depth buffer
     glEnable(GL_DEPTH_TEST);
    
+    runViewer(window);
+
+    // Make sure the loader and ambient occlusion threads are gone before the thread pool and GL context are
+    loader.stop();
+    ambientOcclusionJob.stop();
+    // The global buffers outlive main(); free their GL objects while the context is current
+    instanceBuffer.release();
+    bondBuffer.release();
+    surfaceBuffer.release();
+    cartoonBuffer.release();
+
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+        glfwTerminate();
+        return 0;
+}
+
+// Creates the shaders and renderers and runs the render loop until the window closes. Its GL
+// objects are deleted on return, while the context still exists.
+void runViewer(GLFWwindow* window) {
     // Shader Program
-    Shader ourShader("shaders/atomVertexShader.glsl", "shaders/atomFragmentShader.glsl");
+    // Spheres are only ever scaled uniformly, which the UNIFORM_SCALE variant exploits
+    Shader ourShader("shaders/atomVertexShader.glsl", "shaders/atomFragmentShader.glsl", {"UNIFORM_SCALE"});
+    Shader referenceMeshShader("shaders/atomVertexShader.glsl", "shaders/atomFragmentShader.glsl");
     
+    Shader impostorShader("shaders/atomImpostorVertex.glsl", "shaders/atomImpostorFragment.glsl");
+    Shader lodShader("shaders/atomLodVertex.glsl", "shaders/atomFragmentShader.glsl");
+    Shader bondShader("shaders/bondImpostorVertex.glsl", "shaders/bondImpostorFragment.glsl");
+    Shader surfaceShader("shaders/surfaceVertex.glsl", "shaders/atomFragmentShader.glsl");
+
     // Sphere class
     Sphere sphere;
+    SphereImpostor impostor;
+    SphereLOD sphereLOD;
+    BondImpostor bondImpostor;
+    AtomRenderers renderers{ourShader, referenceMeshShader, impostorShader, lodShader, bondShader, sphere, impostor, sphereLOD, bondImpostor};
+    OcclusionCuller occlusionCuller;
+    // Per-cluster flags of the clusters drawn by an occlusion pass
+    std::vector<uint8_t> passClusters;
+
+    // Instance colors index a palette; the first entries are the CPK element colors
+    std::vector<glm::vec3> palette;
+    for (size_t z = 0; z < elementTable.size(); ++z)
+        palette.push_back(elementColor(static_cast<uint8_t>(z)));
+    palette.resize(sasaPaletteFirst, glm::vec3(0.5f));
+    for (size_t k = sasaPaletteFirst; k < InstanceBuffer::paletteSize; ++k) {
+        float t = static_cast<float>(k - sasaPaletteFirst) / (InstanceBuffer::paletteSize - 1 - sasaPaletteFirst);
+        palette.push_back(t < 0.5f ? glm::mix(glm::vec3(0.1f, 0.2f, 0.9f), glm::vec3(1.0f), t * 2.0f)
+                                   : glm::mix(glm::vec3(1.0f), glm::vec3(0.9f, 0.1f, 0.1f), t * 2.0f - 1.0f));
+    }
+    instanceBuffer.setPalette(palette);
+    ourShader.use();
+    ourShader.setInt("palette", 0);
+    referenceMeshShader.use();
+    referenceMeshShader.setInt("palette", 0);
+    impostorShader.use();
+    impostorShader.setInt("palette", 0);
+    lodShader.use();
+    lodShader.setInt("palette", 0);
+    lodShader.setInt("instancePositions", 1);
+    lodShader.setInt("instanceAppearance", 2);
+    bondShader.use();
+    bondShader.setInt("palette", 0);
+    bondShader.setInt("instancePositions", 1);
+    bondShader.setInt("instanceAppearance", 2);
     
    
    
@@ -153,6 +384,8 @@ int main() {
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
     
+        instanceBuffer.beginFrame();
+
         glfwPollEvents();
         // input
         processInput(window);
@@ -164,28 +397,74 @@ int main() {
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
         drawGui();
-        ourShader.use();
+        pollLoader();
+        updatePlayback(deltaTime);
+        updateAmbientOcclusion();
         // Setup camera matrices
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        ourShader.setVec3("lightPos", lightPos);
-        ourShader.setVec3("viewPos", camera.Position);
-        // Set up + draw meshes
-        sphere.drawInstances(instances);
+        // Push any changed instance ranges, then draw meshes
+        instanceBuffer.sync(instances);
+        instanceBuffer.bindPalette(0);
+        if (sasaColorsStale && !loader.busy() && !timelineMoving())
+            applyColorMode();
+        if (surfaceDirty && !loader.busy() && (surfaceFollowsTimeline() || !timelineMoving()))
+            updateSurface(palette);
+        if (cartoonDirty && !loader.busy())
+            updateCartoon();
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        // Level of detail picks meshes by projected size in real pixels, HiDPI and resizes included
+        float viewportHeight = static_cast<float>(framebufferHeight);
+        if (benchmarkRenderersRequested) {
+            benchmarkSphereRenderers(renderers, view, projection, viewportHeight);
+            benchmarkMeshShaderVariants(renderers, view, projection);
+            benchmarkRenderersRequested = false;
+        }
+        // Everything is drawn while a file is still streaming in; the hierarchy is built once it is complete
+        lodInstancesLastFrame.fill(0);
+        bool haveClusters = !clusterBVH.empty() && clusterBVH.atomCount() == instanceBuffer.size();
+        if (occlusionHistoryStale) {
+            occlusionCuller.reset();
+            occlusionHistoryStale = false;
+        }
+        if (showAtoms && frustumCulling && occlusionCulling && haveClusters && framebufferWidth > 1 && framebufferHeight > 1) {
+            // Pass 1 draws what was visible last frame, pass 2 what the depth pyramid shows was missed
+            glm::mat4 viewProjection = projection * view;
+            occlusionCuller.beginScene(framebufferWidth, framebufferHeight, glm::vec4(0.2f, 0.2f, 0.2f, 1.0f));
+            // The surface and cartoon go in first, so they occlude the atoms buried under them
+            drawSurface(surfaceShader, view, projection);
+            drawCartoon(surfaceShader, view, projection);
+            clusterBVH.cull(viewProjection, visibleRanges, ThreadPool::global());
+            occlusionCuller.firstPass(clusterBVH, passClusters);
+            clusterBVH.rangesOf(passClusters, visibleRanges);
+            atomTrianglesLastFrame = drawAtoms(renderers, atomRenderer, view, projection, viewportHeight);
+            atomTrianglesLastFrame += drawBonds(renderers, view, projection);
+            occlusionCuller.secondPass(clusterBVH, viewProjection, ThreadPool::global(), passClusters);
+            clusterBVH.rangesOf(passClusters, visibleRanges);
+            atomTrianglesLastFrame += drawAtoms(renderers, atomRenderer, view, projection, viewportHeight);
+            atomTrianglesLastFrame += drawBonds(renderers, view, projection);
+            occlusionCuller.endScene();
+            occlusionClustersDrawn = occlusionCuller.firstPassClusters() + occlusionCuller.secondPassClusters();
+            occlusionClustersHidden = occlusionCuller.occludedClusters();
+        } else {
+            if (frustumCulling && haveClusters)
+                clusterBVH.cull(projection * view, visibleRanges, ThreadPool::global());
+            else
+                visibleRanges.assign(1, {0, static_cast<uint32_t>(instanceBuffer.size())});
+            drawSurface(surfaceShader, view, projection);
+            drawCartoon(surfaceShader, view, projection);
+            atomTrianglesLastFrame = 0;
+            if (showAtoms) {
+                atomTrianglesLastFrame = drawAtoms(renderers, atomRenderer, view, projection, viewportHeight);
+                atomTrianglesLastFrame += drawBonds(renderers, view, projection);
+            }
+        }
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glfwSwapBuffers(window);
     }
-
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-        ImGui_ImplOpenGL3_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
-        ImGui::DestroyContext();
-        glfwTerminate();
-        return 0;
 }
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
@@ -282,47 +561,760 @@ unsigned int loadTexture(char const * path)
 }
 
 
-// Parse PDB file
+// Parse PDB file on the background loader; atoms arrive through pollLoader()
 void loadPDBFile(const std::string& filePath) {
     std::cout << "Loading file: " << filePath << std::endl;
     instances.clear();
-    std::ifstream inputFile(filePath);
-    std::string line;
-    if (inputFile.is_open()) { // Check if the file opened successfully
-        while (std::getline(inputFile, line)) { // Read line by line    
-            if (line.substr(0, 6) == "ATOM  ") {
-                std::string element = line.substr(76, 2);
-                float x = std::stof(line.substr(30, 8));
-                float y = std::stof(line.substr(38, 8));
-                float z = std::stof(line.substr(46, 8));
-                glm::vec3 position = glm::vec3(x, y, z);
-                // Trim spaces from element string
-                element.erase(remove_if(element.begin(), element.end(), ::isspace), element.end());
-                Atom atom(element, position);
-                glm::vec3 color = atom.getAtomColor(atom.element, elementColors);
-                float radius = atom.getAtomicRadius(atom.element, elementRadii);
-                instances.emplace_back(atom.position, radius, color);
-            }
+    structure.clear();
+    trajectory.clear();
+    clusterBVH.clear();
+    bondBuffer.clear();
+    surfaceBuffer.clear();
+    cartoon.clear();
+    cartoonBuffer.clear();
+    atomSASA.clear();
+    invalidateAmbientOcclusion();
+    currentFrame = 0;
+    playing = false;
+    streamedModels = 0;
+    instanceBuffer.upload(instances);
+    loader.start(filePath, useStructureCache,
+                 [ordering = spatialAtomOrder, style = atomStyle](Structure& loaded, Trajectory& frames) {
+                     prepareLoadedStructure(loaded, frames, ordering, style);
+                 });
+}
+
+// Streams the instances of a parsed batch to the GPU for progressive display. The structure
+// itself is assembled on the loader thread and taken over once the load finishes.
+void appendAtoms(const Structure& batch) {
+    // Only atoms of the first model are drawn; later models become frames
+    size_t end = streamedModels >= 2 ? 0 : batch.size();
+    for (const ModelStart& model : batch.models) {
+        if (++streamedModels == 2)
+            end = static_cast<size_t>(model.atom);
+    }
+    instances.reserve(instances.size() + end);
+    for (size_t i = 0; i < end; ++i) {
+        uint8_t element = batch.element[i];
+        instances.emplace_back(batch.position(i), atomRadius(element), element);
+    }
+    instanceBuffer.append(instances);
+}
+
+// Called once per frame: takes whatever the loader has parsed since the last frame
+void pollLoader() {
+    AsyncLoader::Result result = loader.poll(appendAtoms);
+    if (result == AsyncLoader::Result::Finished) {
+        // Everything below was computed on the loader thread; only the GL uploads happen here
+        loader.takeLoaded(structure, trajectory);
+        std::cout << "Loaded " << structure.size() << " atoms in " << loader.elapsedMilliseconds() << " ms"
+                  << (loader.loadedFromCache() ? " (from cache)" : "") << std::endl;
+        currentFilePath = loader.path();
+        instances = std::move(loadedScene.instances);
+        clusterBVH = std::move(loadedScene.clusterBVH);
+        // Atoms in file order are already on the GPU from the batches
+        if (loadedScene.reordered || instanceBuffer.size() != instances.size())
+            instanceBuffer.upload(instances);
+        if (loadedScene.reordered)
+            std::cout << "Sorted atoms into spatial order in " << loadedScene.orderMilliseconds << " ms" << std::endl;
+        if (loader.bondsFromCache())
+            std::cout << "Read " << structure.bondCount() << " bonds from cache" << std::endl;
+        else
+            std::cout << "Perceived " << structure.bondCount() << " bonds in " << loader.bondMilliseconds() << " ms"
+                      << std::endl;
+        bondBuffer.upload(structure);
+        occlusionHistoryStale = true;
+        // The style changed while the file was loading
+        if (loadedScene.atomStyle != atomStyle)
+            applyAtomStyle();
+        if (colorMode != ColorByElement)
+            applyColorMode();
+        surfaceDirty = true;
+        cartoonDirty = true;
+        invalidateAmbientOcclusion();
+    } else if (result == AsyncLoader::Result::Cancelled || result == AsyncLoader::Result::Failed) {
+        if (result == AsyncLoader::Result::Failed)
+            std::cerr << "Error: Unable to open file." << std::endl;
+        else
+            std::cout << "Loading cancelled" << std::endl;
+        instances.clear();
+        structure.clear();
+        trajectory.clear();
+        clusterBVH.clear();
+        bondBuffer.clear();
+        surfaceBuffer.clear();
+        cartoon.clear();
+        cartoonBuffer.clear();
+        atomSASA.clear();
+        loadedScene = LoadedScene();
+        instanceBuffer.upload(instances);
+    }
+}
+
+// Loader thread, once the file is parsed and its bonds are known: puts the atoms in drawing
+// order and builds the draw data in loadedScene, so none of it stalls the render thread
+void prepareLoadedStructure(Structure& loaded, Trajectory& frames, bool spatialOrdering, int style) {
+    ThreadPool& pool = ThreadPool::global();
+    loadedScene = LoadedScene();
+    loadedScene.atomStyle = style;
+    if (spatialOrdering) {
+        auto orderStart = std::chrono::steady_clock::now();
+        std::vector<uint32_t> order = spatialOrder(loaded);
+        reorderAtoms(loaded, order, pool);
+        frames.reorder(order);
+        loadedScene.reordered = true;
+        loadedScene.orderMilliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - orderStart).count();
+    }
+    loadedScene.instances.reserve(loaded.size());
+    for (size_t i = 0; i < loaded.size(); ++i)
+        loadedScene.instances.emplace_back(loaded.position(i), atomRadius(loaded.element[i], style), loaded.element[i]);
+    loadedScene.clusterBVH.build(loaded, loadedScene.instances, pool);
+}
+
+// Sphere radius of an element in the current style
+float atomRadius(uint8_t element) {
+    return atomRadius(element, atomStyle);
+}
+
+// Sphere radius of an element in the given style
+float atomRadius(uint8_t element, int style) {
+    switch (style) {
+        case StyleBallAndStick:
+            return elementInfo(element).vdwRadius * ballRadiusScale;
+        case StyleLicorice:
+            return licoriceRadius;
+        default:
+            return elementInfo(element).vdwRadius * atomRadiusScale;
+    }
+}
+
+// Resizes every atom for a new style; bonds need no update, only their radius uniform
+void applyAtomStyle() {
+    for (size_t i = 0; i < instances.size(); ++i)
+        instances[i].radius = atomRadius(structure.element[i]);
+    instanceBuffer.markAppearanceDirty(0, instances.size());
+    clusterBVH.refit(instances, ThreadPool::global());
+    occlusionHistoryStale = true;
+    invalidateAmbientOcclusion();
+}
+
+// Marks the ambient occlusion of every atom as out of date
+void invalidateAmbientOcclusion() {
+    ++ambientOcclusionGeneration;
+    ambientOcclusionChangedAt = glfwGetTime();
+}
+
+// Called once per frame: stores a finished background result in the instances (only the
+// appearance is re-uploaded) and starts a new job once the scene has been still for a moment
+void updateAmbientOcclusion() {
+    std::vector<uint8_t> light;
+    uint64_t generation;
+    double milliseconds;
+    if (ambientOcclusionJob.poll(light, generation, milliseconds) && generation == ambientOcclusionGeneration &&
+        light.size() == instances.size()) {
+        for (size_t i = 0; i < instances.size(); ++i)
+            instances[i].ambient = light[i];
+        instanceBuffer.markAppearanceDirty(0, instances.size());
+        ambientOcclusionMilliseconds = milliseconds;
+        std::cout << "Ambient occlusion: " << instances.size() << " atoms in " << milliseconds << " ms" << std::endl;
+    }
+    if (ambientOcclusionStarted == ambientOcclusionGeneration || timelineMoving() || loader.busy() ||
+        glfwGetTime() - ambientOcclusionChangedAt < ambientOcclusionDelay)
+        return;
+    ambientOcclusionStarted = ambientOcclusionGeneration;
+    if (ambientOcclusion && !instances.empty()) {
+        // Replaces a job still working on an older generation
+        ambientOcclusionJob.start(instances, ambientOcclusionGeneration);
+        return;
+    }
+    ambientOcclusionJob.stop();
+    for (SphereInstance& instance : instances)
+        instance.ambient = 255;
+    instanceBuffer.markAppearanceDirty(0, instances.size());
+}
+
+// Computes the solvent-accessible surface area of every atom in the current frame
+void updateSASA() {
+    auto start = std::chrono::steady_clock::now();
+    computeSASA(structure, ThreadPool::global(), atomSASA);
+    float total = 0.0f;
+    for (float area : atomSASA)
+        total += area;
+    std::cout << "SASA: " << total << " A^2 over " << structure.size() << " atoms in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+              << " ms" << std::endl;
+}
+
+// Recolors every atom for the current color mode; only the appearance is re-uploaded
+void applyColorMode() {
+    sasaColorsStale = false;
+    if (colorMode == ColorBySASA && atomSASA.size() != structure.size())
+        updateSASA();
+    for (size_t i = 0; i < instances.size(); ++i) {
+        if (colorMode == ColorBySASA) {
+            float exposed = relativeSASA(structure, atomSASA, i);
+            instances[i].colorIndex = static_cast<uint8_t>(
+                sasaPaletteFirst + std::lround(exposed * (InstanceBuffer::paletteSize - 1 - sasaPaletteFirst)));
+        } else {
+            instances[i].colorIndex = structure.element[i];
         }
-        std::cout << "Loaded " << instances.size() << " atoms" << std::endl;
-        inputFile.close();
+    }
+    instanceBuffer.markAppearanceDirty(0, instances.size());
+    surfaceDirty = true;
+}
+
+// Rebuilds the surface mesh for the current atoms and colors
+void updateSurface(const std::vector<glm::vec3>& palette) {
+    surfaceDirty = false;
+    if (surfaceMode == SurfaceNone || instances.empty()) {
+        surfaceBuffer.clear();
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    SurfaceMesh mesh;
+    if (surfaceMode == SurfaceExcluded)
+        buildSolventExcludedSurface(structure, instances, palette, surfaceResolution, ThreadPool::global(), mesh);
+    else if (surfaceMode == SurfaceAccessible)
+        buildSolventAccessibleSurface(structure, instances, palette, surfaceResolution, ThreadPool::global(), mesh);
+    else
+        buildGaussianSurface(structure, instances, palette, surfaceResolution, gaussianWidth, ThreadPool::global(), mesh);
+    surfaceBuffer.upload(mesh);
+    surfaceBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Only the Gaussian surface is cheap enough to rebuild every frame of playback; the
+// solvent surfaces wait until the timeline stops
+bool surfaceFollowsTimeline() {
+    return surfaceMode == SurfaceGaussian;
+}
+
+// Draws the surface mesh, if one is shown
+void drawSurface(Shader& shader, const glm::mat4& view, const glm::mat4& projection) {
+    if (surfaceMode == SurfaceNone || surfaceBuffer.triangleCount() == 0)
+        return;
+    // A deferred solvent surface belongs to an earlier frame; hide it until it is rebuilt
+    if (surfaceDirty && !surfaceFollowsTimeline())
+        return;
+    setSceneUniforms(shader, view, projection);
+    surfaceBuffer.draw();
+}
+
+// Builds the cartoon for a newly loaded structure, or regenerates the traces that moved
+void updateCartoon() {
+    cartoonDirty = false;
+    if (!showCartoon || structure.empty())
+        return;
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<SecondaryRange>* secondary = &structure.secondary;
+    if (secondarySource == SecondaryComputed || structure.secondary.empty()) {
+        assignSecondaryStructure(structure, ThreadPool::global(), computedSecondary);
+        secondary = &computedSecondary;
+        secondaryMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (cartoon.atomCount() != structure.size()) {
+        cartoon.build(structure, *secondary, ThreadPool::global());
+        cartoonBuffer.upload(cartoon.mesh());
     } else {
+        cartoon.update(structure, *secondary, ThreadPool::global());
+        for (const Cartoon::VertexRange& range : cartoon.changedRanges())
+            cartoonBuffer.updateVertices(cartoon.mesh(), range.first, range.count);
+    }
+    cartoonBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Draws the cartoon, if shown
+void drawCartoon(Shader& shader, const glm::mat4& view, const glm::mat4& projection) {
+    if (!showCartoon || cartoonBuffer.triangleCount() == 0)
+        return;
+    setSceneUniforms(shader, view, projection);
+    cartoonBuffer.draw();
+}
+
+// Writes per-atom and per-residue SASA next to the structure file
+void exportSASA() {
+    if (atomSASA.size() != structure.size())
+        updateSASA();
+    std::string atomPath = currentFilePath + ".sasa.csv";
+    std::string residuePath = currentFilePath + ".residue_sasa.csv";
+    if (!writeAtomSASACsv(atomPath, structure, atomSASA) || !writeResidueSASACsv(residuePath, structure, atomSASA)) {
+        std::cerr << "Error: Unable to write SASA files." << std::endl;
+        return;
+    }
+    std::cout << "Wrote " << atomPath << " and " << residuePath << std::endl;
+}
+
+// Moves every atom to the coordinates of a trajectory frame; only positions are re-uploaded
+void showFrame(int frame) {
+    if (frame == currentFrame || frame < 0 || frame >= static_cast<int>(trajectory.frameCount()))
+        return;
+    currentFrame = frame;
+    trajectory.applyFrame(frame, structure);
+    for (size_t i = 0; i < instances.size(); ++i)
+        instances[i].position = structure.position(i);
+    instanceBuffer.markPositionsDirty(0, instances.size());
+    clusterBVH.refit(instances, ThreadPool::global());
+    atomSASA.clear();
+    if (colorMode == ColorBySASA)
+        sasaColorsStale = true;
+    surfaceDirty = true;
+    cartoonDirty = true;
+    invalidateAmbientOcclusion();
+}
+
+// Frames are changing continuously, through playback or the slider
+bool timelineMoving() {
+    return playing || scrubbingTimeline;
+}
+
+// Advances the timeline while playing
+void updatePlayback(float dt) {
+    int frames = static_cast<int>(trajectory.frameCount());
+    if (!playing || frames < 2)
+        return;
+    playbackTimer += dt;
+    float step = 1.0f / playbackFps;
+    int next = currentFrame;
+    while (playbackTimer >= step) {
+        playbackTimer -= step;
+        ++next;
+    }
+    if (next >= frames) {
+        if (loopPlayback) {
+            next %= frames;
+        } else {
+            next = frames - 1;
+            playing = false;
+        }
+    }
+    showFrame(next);
+}
+
+// Times the chunked parser on 1..N threads and prints the speedup over one thread
+void benchmarkParserScaling(const std::string& filePath) {
+    MappedFile inputFile(filePath);
+    if (!inputFile.is_open()) {
         std::cerr << "Error: Unable to open file." << std::endl;
+        return;
+    }
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double baseline = 0.0;
+    Structure parsed;
+    std::cout << "Parser scaling on " << inputFile.size() / (1024.0 * 1024.0) << " MB:" << std::endl;
+    // Powers of two, plus the full core count as the last step
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+    for (unsigned threads : threadCounts) {
+        ThreadPool pool(threads);
+        double best = 1e30;
+        for (int run = 0; run < 3; ++run) {
+            parsed.clear();
+            auto start = std::chrono::steady_clock::now();
+            parsePDBAtomsParallel(inputFile.view(), parsed, pool);
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        if (threads == 1)
+            baseline = best;
+        std::cout << "  " << threads << " threads: " << best << " ms, "
+                  << inputFile.size() / (best * 1000.0) << " MB/s, speedup " << baseline / best << "x" << std::endl;
+    }
+}
+
+// Times the spatial index queries against brute force on the loaded atoms and checks that
+// both find the same neighbors. Brute force runs on a sample of query atoms, and its pair
+// enumeration on a prefix of the structure, so the benchmark stays quick on large files.
+void benchmarkSpatialIndex() {
+    using Clock = std::chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    ThreadPool& pool = ThreadPool::global();
+    const float radius = 5.0f;
+    const size_t k = 8;
+    size_t n = instances.size();
+    std::cout << "Spatial index on " << n << " atoms:" << std::endl;
+
+    SpatialIndex index;
+    auto start = Clock::now();
+    index.build(instances, radius, pool);
+    std::cout << "  build: " << elapsed(start) << " ms, " << index.cellCount() << " cells" << std::endl;
+    start = Clock::now();
+    index.update(instances, pool);
+    std::cout << "  update (unmoved): " << elapsed(start) << " ms" << std::endl;
+
+    // Every atom up to 2000 query centers, spread over the structure
+    std::vector<glm::vec3> centers;
+    size_t stride = std::max<size_t>(1, n / 2000);
+    for (size_t i = 0; i < n; i += stride)
+        centers.push_back(instances[i].position);
+
+    std::vector<uint32_t> offsets, atoms;
+    start = Clock::now();
+    index.radiusQueries(centers, radius, pool, offsets, atoms);
+    double indexed = elapsed(start);
+    size_t bruteCount = 0;
+    start = Clock::now();
+    for (const glm::vec3& center : centers) {
+        for (const SphereInstance& atom : instances) {
+            glm::vec3 d = atom.position - center;
+            bruteCount += glm::dot(d, d) < radius * radius;
+        }
+    }
+    double brute = elapsed(start);
+    std::cout << "  " << centers.size() << " radius queries: " << indexed << " ms, brute force " << brute
+              << " ms, " << atoms.size() << (atoms.size() == bruteCount ? " hits (match)" : " hits (MISMATCH)") << std::endl;
+
+    std::vector<uint32_t> nearest;
+    std::vector<float> distances(n);
+    size_t mismatches = 0;
+    indexed = 0.0;
+    brute = 0.0;
+    for (const glm::vec3& center : centers) {
+        start = Clock::now();
+        index.nearest(center, k, nearest);
+        indexed += elapsed(start);
+        start = Clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            glm::vec3 d = instances[i].position - center;
+            distances[i] = glm::dot(d, d);
+        }
+        size_t found = std::min(k, n);
+        std::nth_element(distances.begin(), distances.begin() + (found - 1), distances.end());
+        brute += elapsed(start);
+        glm::vec3 d = instances[nearest.back()].position - center;
+        mismatches += nearest.size() != found || glm::dot(d, d) != distances[found - 1];
+    }
+    std::cout << "  " << centers.size() << " " << k << "-nearest queries: " << indexed << " ms, brute force "
+              << brute << " ms, " << mismatches << " mismatches" << std::endl;
+
+    std::vector<SpatialIndex::Pair> pairs;
+    start = Clock::now();
+    index.pairs(radius, pool, pairs);
+    std::cout << "  pairs within " << radius << " A: " << elapsed(start) << " ms, " << pairs.size() << " pairs" << std::endl;
+
+    // All-pairs brute force is quadratic: compare on the first atoms only
+    std::vector<SphereInstance> prefix(instances.begin(), instances.begin() + std::min<size_t>(n, 10000));
+    SpatialIndex prefixIndex;
+    start = Clock::now();
+    prefixIndex.build(prefix, radius, pool);
+    prefixIndex.pairs(radius, pool, pairs);
+    indexed = elapsed(start);
+    bruteCount = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        for (size_t j = i + 1; j < prefix.size(); ++j) {
+            glm::vec3 d = prefix[j].position - prefix[i].position;
+            bruteCount += glm::dot(d, d) < radius * radius;
+        }
+    }
+    brute = elapsed(start);
+    std::cout << "  pairs among " << prefix.size() << " atoms (with build): " << indexed << " ms, brute force "
+              << brute << " ms, " << pairs.size() << (pairs.size() == bruteCount ? " pairs (match)" : " pairs (MISMATCH)") << std::endl;
+}
+
+// Times the kernels that walk atoms in memory order on the structure in file order and in
+// spatial order. Bond index distance stands in for GPU vertex fetch locality: bond
+// impostors fetch both atoms, and draw ranges count the instance runs culling leaves.
+void benchmarkAtomOrder() {
+    using Clock = std::chrono::steady_clock;
+    auto elapsed = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    ThreadPool& pool = ThreadPool::global();
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+    glm::mat4 viewProjection = projection * camera.GetViewMatrix();
+
+    Structure fileOrdered = structure;
+    reorderAtoms(fileOrdered, fileOrderOf(fileOrdered), pool);
+    fileOrdered.fileOrder.clear();
+    Structure spatial = fileOrdered;
+    auto start = Clock::now();
+    reorderAtoms(spatial, spatialOrder(spatial), pool);
+    std::cout << "Atom order on " << structure.size() << " atoms (sort: " << elapsed(start) << " ms):" << std::endl;
+
+    const Structure* orders[2] = {&fileOrdered, &spatial};
+    const char* const orderNames[2] = {"file", "spatial"};
+    for (int o = 0; o < 2; ++o) {
+        Structure atoms = *orders[o];
+        std::vector<SphereInstance> orderedInstances;
+        orderedInstances.reserve(atoms.size());
+        for (size_t i = 0; i < atoms.size(); ++i)
+            orderedInstances.emplace_back(atoms.position(i), atomRadius(atoms.element[i]), atoms.element[i]);
+
+        start = Clock::now();
+        perceiveBonds(atoms, pool);
+        double bonds = elapsed(start);
+
+        // Neighbor counts around every atom, queried in atom order as SASA-style kernels do
+        SpatialIndex index;
+        start = Clock::now();
+        index.build(atoms, 5.0f, pool);
+        std::vector<glm::vec3> centers(orderedInstances.size());
+        for (size_t i = 0; i < centers.size(); ++i)
+            centers[i] = orderedInstances[i].position;
+        std::vector<uint32_t> offsets, neighbors;
+        index.radiusQueries(centers, 5.0f, pool, offsets, neighbors);
+        double queries = elapsed(start);
+
+        // Bond lengths through the CSR, gathering both ends like the bond shader does
+        start = Clock::now();
+        double lengthSum = 0.0;
+        double indexDistance = 0.0;
+        for (size_t i = 0; i < atoms.size(); ++i) {
+            for (uint32_t k = atoms.bondOffsets[i]; k < atoms.bondOffsets[i + 1]; ++k) {
+                uint32_t j = atoms.bondNeighbors[k];
+                lengthSum += glm::length(atoms.position(j) - atoms.position(i));
+                indexDistance += j > i ? j - i : i - j;
+            }
+        }
+        double sweep = elapsed(start);
+
+        ClusterBVH clusters;
+        std::vector<InstanceRange> ranges;
+        start = Clock::now();
+        clusters.build(atoms, orderedInstances, pool);
+        double clusterBuild = elapsed(start);
+        start = Clock::now();
+        clusters.cull(viewProjection, ranges, pool);
+        double cull = elapsed(start);
+
+        double bondEnds = std::max<double>(1.0, atoms.bondNeighbors.size());
+        std::cout << "  " << orderNames[o] << " order: bonds " << bonds << " ms, radius queries " << queries
+                  << " ms (" << neighbors.size() << " hits), bond sweep " << sweep << " ms (mean length "
+                  << lengthSum / bondEnds << " A), mean bond index distance " << indexDistance / bondEnds
+                  << ", cluster build " << clusterBuild << " ms, cull " << cull << " ms, " << ranges.size()
+                  << " draw ranges for " << clusters.visibleAtoms() << " atoms" << std::endl;
+    }
+}
+
+// Binds `shader` and sets the camera and light uniforms shared by the atom shaders
+void setSceneUniforms(Shader& shader, const glm::mat4& view, const glm::mat4& projection) {
+    shader.use();
+    shader.setMat4("view", view);
+    shader.setMat4("projection", projection);
+    shader.setVec3("lightPos", lightPos);
+    shader.setVec3("viewPos", camera.Position);
+}
+
+// Draws the visible atoms with the given renderer and returns the number of triangles submitted
+size_t drawAtoms(AtomRenderers& renderers, int renderer, const glm::mat4& view, const glm::mat4& projection,
+                 float viewportHeight) {
+    size_t drawn = 0;
+    for (const InstanceRange& range : visibleRanges)
+        drawn += range.count;
+    switch (renderer) {
+        case RenderImpostors:
+            setSceneUniforms(renderers.impostorShader, view, projection);
+            renderers.impostor.drawInstances(instanceBuffer, visibleRanges);
+            return drawn * SphereImpostor::trianglesPerInstance;
+        case RenderMeshLOD:
+            setSceneUniforms(renderers.lodShader, view, projection);
+            instanceBuffer.bindInstanceTextures(1, 2);
+            renderers.lod.drawInstances(instanceBuffer, instances, visibleRanges, view, projection, viewportHeight);
+            instanceBuffer.countUpload(renderers.lod.bytesUploadedLastDraw());
+            for (int level = 0; level < SphereLOD::levelCount; ++level)
+                lodInstancesLastFrame[level] += renderers.lod.instancesDrawn(level);
+            return renderers.lod.trianglesLastFrame();
+        default:
+            setSceneUniforms(renderers.meshShader, view, projection);
+            renderers.sphere.drawInstances(instanceBuffer, visibleRanges);
+            return drawn * renderers.sphere.triangleCount();
+    }
+}
+
+// Draws the bonds of the visible atoms as cylinders and returns the number of triangles submitted
+size_t drawBonds(AtomRenderers& renderers, const glm::mat4& view, const glm::mat4& projection) {
+    if (atomStyle == StyleSpaceFilling || bondBuffer.size() == 0 || bondBuffer.atomCount() != instanceBuffer.size())
+        return 0;
+    setSceneUniforms(renderers.bondShader, view, projection);
+    renderers.bondShader.setFloat("bondRadius", atomStyle == StyleLicorice ? licoriceRadius : ballAndStickBondRadius);
+    instanceBuffer.bindInstanceTextures(1, 2);
+    renderers.bonds.drawInstances(bondBuffer, visibleRanges);
+    return renderers.bonds.bondsDrawn() * BondImpostor::trianglesPerInstance;
+}
+
+// Times every atom renderer on the GPU with timer queries and prints the results
+void benchmarkSphereRenderers(AtomRenderers& renderers, const glm::mat4& view, const glm::mat4& projection,
+                              float viewportHeight) {
+    const int draws = 20;
+    GLuint query;
+    glGenQueries(1, &query);
+    // Time every atom rather than whatever the last culling pass left in visibleRanges
+    std::vector<InstanceRange> culledRanges;
+    culledRanges.swap(visibleRanges);
+    visibleRanges.assign(1, {0, static_cast<uint32_t>(instanceBuffer.size())});
+    std::cout << "Sphere renderers, " << visibleRanges[0].count << " atoms drawn, best of " << draws << " draws:" << std::endl;
+    for (int renderer = 0; renderer < AtomRendererCount; ++renderer) {
+        double best = 1e30;
+        size_t triangles = 0;
+        for (int i = 0; i < draws; ++i) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            triangles = drawAtoms(renderers, renderer, view, projection, viewportHeight);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            best = std::min(best, nanoseconds / 1e6);
+        }
+        std::cout << "  " << atomRendererNames[renderer] << ": " << best << " ms, " << triangles / 1e6
+                  << " M triangles, " << triangles / (best * 1e3) << " M triangles/s" << std::endl;
     }
+    glDeleteQueries(1, &query);
+    visibleRanges.swap(culledRanges);
+    // Leave a clean frame for the real draw
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Times the two variants of atomVertexShader.glsl on the instanced mesh with rasterization
+// turned off, so only vertex work is measured. Under a software driver (e.g. Mesa llvmpipe
+// with LIBGL_ALWAYS_SOFTWARE=1) this is the CPU cost per vertex of each variant.
+void benchmarkMeshShaderVariants(AtomRenderers& renderers, const glm::mat4& view, const glm::mat4& projection) {
+    const int draws = 20;
+    GLuint query;
+    glGenQueries(1, &query);
+    // A fixed workload: every instance, independent of camera and occlusion history
+    std::vector<InstanceRange> allAtoms(1, {0, static_cast<uint32_t>(instanceBuffer.size())});
+    size_t atoms = instanceBuffer.size();
+    double vertices = static_cast<double>(atoms) * renderers.sphere.vertexCount();
+    std::cout << "Mesh vertex shader on " << glGetString(GL_RENDERER) << ", " << atoms << " atoms, "
+              << vertices / 1e6 << " M vertices, best of " << draws << " draws:" << std::endl;
+    glEnable(GL_RASTERIZER_DISCARD);
+    Shader* variants[2] = {&renderers.referenceMeshShader, &renderers.meshShader};
+    const char* variantNames[2] = {"model matrix + inverse", "uniform scale"};
+    for (int v = 0; v < 2; ++v) {
+        double best = 1e30;
+        for (int i = 0; i < draws; ++i) {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            setSceneUniforms(*variants[v], view, projection);
+            renderers.sphere.drawInstances(instanceBuffer, allAtoms);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            best = std::min(best, nanoseconds / 1e6);
+        }
+        std::cout << "  " << variantNames[v] << ": " << best << " ms, " << vertices / (best * 1e3) << " M vertices/s"
+                  << std::endl;
+    }
+    glDisable(GL_RASTERIZER_DISCARD);
+    glDeleteQueries(1, &query);
 }
 
 // imgui file dialog
 void drawGui() {
     if (ImGui::Begin("##OpenDialogCommand")) {
         if (ImGui::Button("Open File Dialog")) {
-            const char *filters = "PDB files (*.pdb){.pdb},";
+            const char *filters = "Structure files (*.pdb *.cif *.gz){.pdb,.cif,.mmcif,.pdb.gz,.cif.gz,.ent.gz},PDB files (*.pdb *.pdb.gz){.pdb,.pdb.gz,.ent.gz},mmCIF files (*.cif *.cif.gz){.cif,.mmcif,.cif.gz},";
             IGFD::FileDialogConfig config;
             config.path = ".";
             ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", filters, config);
         }
+        ImGui::Text("Atoms: %zu", instanceBuffer.size());
+        ImGui::Text("Bonds: %zu", structure.bondCount());
+        ImGui::Text("Instance upload: %zu bytes/frame", instanceBuffer.bytesUploadedLastFrame());
+        ImGui::Checkbox("Use structure cache", &useStructureCache);
+        ImGui::Checkbox("Spatial atom order", &spatialAtomOrder);
+        // A load in flight picks up style and color changes when it finishes (see pollLoader)
+        if (ImGui::Combo("Style", &atomStyle, atomStyleNames, AtomStyleCount) && !loader.busy())
+            applyAtomStyle();
+        if (ImGui::Checkbox("Ambient occlusion", &ambientOcclusion))
+            invalidateAmbientOcclusion();
+        if (ambientOcclusion && instanceBuffer.size() > 0) {
+            ImGui::SameLine();
+            if (ambientOcclusionJob.busy())
+                ImGui::Text("computing...");
+            else
+                ImGui::Text("%.1f ms", ambientOcclusionMilliseconds);
+        }
+        if (ImGui::Combo("Color", &colorMode, colorModeNames, ColorModeCount) && instanceBuffer.size() > 0 &&
+            !loader.busy())
+            applyColorMode();
+        if (!currentFilePath.empty() && !loader.busy() && ImGui::Button("Export SASA"))
+            exportSASA();
+        if (ImGui::Combo("Surface", &surfaceMode, surfaceModeNames, SurfaceModeCount))
+            surfaceDirty = true;
+        if (surfaceMode != SurfaceNone) {
+            // Rebuild once the slider is let go, not on every step of a drag
+            ImGui::SliderFloat("Surface resolution (A)", &surfaceResolution, 0.25f, 2.0f, "%.2f");
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                surfaceDirty = true;
+            if (surfaceMode == SurfaceGaussian) {
+                ImGui::SliderFloat("Gaussian width", &gaussianWidth, 0.3f, 1.0f, "%.2f");
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                    surfaceDirty = true;
+            }
+            ImGui::Text("Surface: %zu triangles, built in %.1f ms", surfaceBuffer.triangleCount(), surfaceBuildMilliseconds);
+        }
+        if (ImGui::Checkbox("Cartoon", &showCartoon) && showCartoon)
+            cartoonDirty = true;
+        ImGui::SameLine();
+        ImGui::Checkbox("Show atoms", &showAtoms);
+        if (showCartoon) {
+            if (ImGui::Combo("Secondary structure", &secondarySource, secondarySourceNames, SecondarySourceCount))
+                cartoonDirty = true;
+            ImGui::Text("Cartoon: %zu residues, %zu triangles, built in %.1f ms", cartoon.residueCount(),
+                        cartoonBuffer.triangleCount(), cartoonBuildMilliseconds);
+            if (secondarySource == SecondaryComputed || structure.secondary.empty())
+                ImGui::Text("Secondary structure: %zu helices and strands, assigned in %.1f ms", computedSecondary.size(),
+                            secondaryMilliseconds);
+        }
+        ImGui::Combo("Atoms", &atomRenderer, atomRendererNames, AtomRendererCount);
+        ImGui::Text("Triangles: %.2f M/frame, %.0f M/s", atomTrianglesLastFrame / 1e6,
+                    deltaTime > 0.0f ? atomTrianglesLastFrame / (deltaTime * 1e6) : 0.0);
+        if (atomRenderer == RenderMeshLOD)
+            ImGui::Text("Atoms per LOD (coarse to fine): %zu / %zu / %zu / %zu", lodInstancesLastFrame[0],
+                        lodInstancesLastFrame[1], lodInstancesLastFrame[2], lodInstancesLastFrame[3]);
+        ImGui::Checkbox("Frustum culling", &frustumCulling);
+        if (frustumCulling && !clusterBVH.empty()) {
+            ImGui::Text("Visible: %zu of %zu clusters, %zu atoms drawn, %zu culled", clusterBVH.visibleClusters(),
+                        clusterBVH.clusterCount(), clusterBVH.visibleAtoms(), clusterBVH.atomCount() - clusterBVH.visibleAtoms());
+            ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+            if (occlusionCulling)
+                ImGui::Text("Occlusion: %zu clusters drawn, %zu hidden", occlusionClustersDrawn, occlusionClustersHidden);
+            else
+                ImGui::Text("Draw ranges: %zu", visibleRanges.size());
+        }
+        if (instanceBuffer.size() > 0 && ImGui::Button("Benchmark sphere renderers"))
+            benchmarkRenderersRequested = true;
+        if (loader.busy()) {
+            ImGui::Text("%s %s", loader.phaseName(), loader.path().c_str());
+            ImGui::ProgressBar(loader.progress());
+            if (ImGui::Button("Cancel"))
+                loader.cancel();
+        }
+        if (!currentFilePath.empty() && !loader.busy() && ImGui::Button("Benchmark parser scaling"))
+            benchmarkParserScaling(currentFilePath);
+        if (instanceBuffer.size() > 0 && !loader.busy() && ImGui::Button("Benchmark spatial index"))
+            benchmarkSpatialIndex();
+        if (instanceBuffer.size() > 0 && !loader.busy() && ImGui::Button("Benchmark atom order"))
+            benchmarkAtomOrder();
     }
     ImGui::End();
 
+    // Timeline for NMR ensembles and multi-frame trajectories
+    int frames = static_cast<int>(trajectory.frameCount());
+    scrubbingTimeline = false;
+    if (frames > 1 && !loader.busy()) {
+        if (ImGui::Begin("Timeline")) {
+            if (ImGui::Button(playing ? "Pause" : "Play")) {
+                if (!playing && !loopPlayback && currentFrame == frames - 1)
+                    showFrame(0);
+                playing = !playing;
+                playbackTimer = 0.0f;
+            }
+            ImGui::SameLine();
+            ImGui::Checkbox("Loop", &loopPlayback);
+            int frame = currentFrame;
+            if (ImGui::SliderInt("Frame", &frame, 0, frames - 1))
+                showFrame(frame);
+            scrubbingTimeline = ImGui::IsItemActive();
+            ImGui::Text("Model %d of %d", trajectory.modelSerial(currentFrame), frames);
+            ImGui::SliderFloat("Frames/s", &playbackFps, 1.0f, 60.0f);
+        }
+        ImGui::End();
+    }
+
     // Handle file dialog
     if (ImGuiFileDialog::Instance()->Display("ChooseFileDlgKey")) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
@@ -7,13 +7,16 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
-    Shader(const char* vertexPath, const char* fragmentPath) {
+    // constructor generates the shader on the fly. Every name in `defines` becomes a
+    // "#define NAME" line right after the #version line of both stages, which selects
+    // compile-time variants of one source file.
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {}) {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
@@ -34,8 +37,8 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            vertexCode   = withDefines(vShaderStream.str(), defines);
+            fragmentCode = withDefines(fShaderStream.str(), defines);
         }
         catch (std::ifstream::failure& e) {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
@@ -64,6 +67,13 @@ public:
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
+    // the program is deleted with the object, so it must go while the GL context is current
+    ~Shader() {
+        glDeleteProgram(ID);
+    }
+    // a copy would delete the same program twice
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
     // activate the shader
     void use() { 
         glUseProgram(ID); 
@@ -109,6 +119,21 @@ public:
     }
 
 private:
+    // inserts the defines after the #version line, which must stay the first directive
+    static std::string withDefines(const std::string& source, const std::vector<std::string>& defines) {
+        if (defines.empty())
+            return source;
+        std::string block;
+        for (const std::string& name : defines)
+            block += "#define " + name + "\n";
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return block + source;
+        size_t lineEnd = source.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return source + "\n" + block;
+        return source.substr(0, lineEnd + 1) + block + source.substr(lineEnd + 1);
+    }
     // utility function for checking shader compilation/linking errors.
     void checkCompileErrors(unsigned int shader, std::string type) {
         int success;